@@ -0,0 +1,487 @@
+#include "thread/job_system.h"
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+const long fromJobs = 64;
+const long toJobs = 1 << 12;
+const int maxWorkers = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+// Busy work of a scaling job, roughly a microsecond
+constexpr int workIterations = 256;
+
+void DoWork()
+{
+    std::uint32_t value = 0;
+    for (int i = 0; i < workIterations; i++)
+    {
+        value = value * 1664525u + 1013904223u;
+        benchmark::DoNotOptimize(value);
+    }
+}
+
+class EmptyJob : public neko::Job
+{
+protected:
+    void ExecuteImpl() override {}
+};
+
+class WorkJob : public neko::Job
+{
+protected:
+    void ExecuteImpl() override { DoWork(); }
+};
+
+class EmptyDependentJob : public neko::DependentJob
+{
+public:
+    using DependentJob::DependentJob;
+protected:
+    void ExecuteImpl() override {}
+};
+
+class EmptyDependenciesJob : public neko::DependenciesJob
+{
+protected:
+    void ExecuteImpl() override {}
+};
+
+/**
+ * \brief RawThreadPool is the baseline for the scheduler: one mutex protected queue of std::function
+ * shared by all the threads, without priorities, dependencies or pooling.
+ */
+class RawThreadPool
+{
+public:
+    explicit RawThreadPool(int threadCount)
+    {
+        for (int i = 0; i < threadCount; i++)
+        {
+            threads_.emplace_back([this] { Run(); });
+        }
+    }
+
+    ~RawThreadPool()
+    {
+        {
+            std::scoped_lock lock(mutex_);
+            isRunning_ = false;
+        }
+        condition_.notify_all();
+        for (auto& thread : threads_)
+        {
+            thread.join();
+        }
+    }
+
+    void Push(std::function<void()> task)
+    {
+        pendingTasks_.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::scoped_lock lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        condition_.notify_one();
+    }
+
+    void Wait()
+    {
+        auto pending = pendingTasks_.load(std::memory_order_acquire);
+        while (pending != 0)
+        {
+            pendingTasks_.wait(pending, std::memory_order_acquire);
+            pending = pendingTasks_.load(std::memory_order_acquire);
+        }
+    }
+private:
+    void Run()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(mutex_);
+                condition_.wait(lock, [this] { return !tasks_.empty() || !isRunning_; });
+                if (tasks_.empty())
+                {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+            if (pendingTasks_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                pendingTasks_.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::thread> threads_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::atomic<int> pendingTasks_{0};
+    bool isRunning_ = true;
+};
+
+template<typename JobType>
+std::vector<std::unique_ptr<JobType>> MakeJobs(std::size_t count, std::vector<neko::Job*>& jobPtrs)
+{
+    std::vector<std::unique_ptr<JobType>> jobs;
+    jobs.reserve(count);
+    jobPtrs.clear();
+    for (std::size_t i = 0; i < count; i++)
+    {
+        jobs.push_back(std::make_unique<JobType>());
+        jobPtrs.push_back(jobs.back().get());
+    }
+    return jobs;
+}
+}
+
+static void BM_EmptyJobs(benchmark::State& state)
+{
+    const auto n = static_cast<std::size_t>(state.range(0));
+    neko::JobScheduler scheduler;
+    const int queueIndex = scheduler.SetupNewQueue(maxWorkers);
+    scheduler.Begin();
+    std::vector<neko::Job*> jobPtrs;
+    auto jobs = MakeJobs<EmptyJob>(n, jobPtrs);
+    neko::JobCounter counter;
+
+    for (auto _ : state)
+    {
+        scheduler.AddJobs(jobPtrs, counter, queueIndex);
+        counter.Wait();
+    }
+    scheduler.End();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_EmptyJobs)->Range(fromJobs, toJobs)->UseRealTime();
+
+static void BM_SubmitEmptyFunctions(benchmark::State& state)
+{
+    const auto n = state.range(0);
+    neko::JobScheduler scheduler;
+    const int queueIndex = scheduler.SetupNewQueue(maxWorkers);
+    scheduler.Begin();
+    std::atomic<long> executed{0};
+
+    for (auto _ : state)
+    {
+        executed.store(0, std::memory_order_relaxed);
+        for (long i = 0; i < n; i++)
+        {
+            scheduler.Submit([&executed] { executed.fetch_add(1, std::memory_order_relaxed); }, queueIndex);
+        }
+        while (executed.load(std::memory_order_acquire) != n)
+        {
+            std::this_thread::yield();
+        }
+    }
+    scheduler.End();
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+BENCHMARK(BM_SubmitEmptyFunctions)->Range(fromJobs, toJobs)->UseRealTime();
+
+static void BM_FanOutFanIn(benchmark::State& state)
+{
+    const auto n = static_cast<std::size_t>(state.range(0));
+    neko::JobScheduler scheduler;
+    const int queueIndex = scheduler.SetupNewQueue(maxWorkers);
+    scheduler.Begin();
+    EmptyJob root;
+    std::vector<std::unique_ptr<EmptyDependentJob>> fanOut;
+    EmptyDependenciesJob fanIn;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        fanOut.push_back(std::make_unique<EmptyDependentJob>(&root));
+        fanIn.AddDependency(fanOut.back().get());
+    }
+
+    for (auto _ : state)
+    {
+        scheduler.AddJob(&root, queueIndex);
+        for (auto& job : fanOut)
+        {
+            scheduler.AddJob(job.get(), queueIndex);
+        }
+        scheduler.AddJob(&fanIn, queueIndex);
+        fanIn.Join();
+    }
+    scheduler.End();
+    state.SetItemsProcessed(state.iterations() * static_cast<long>(n + 2));
+}
+
+BENCHMARK(BM_FanOutFanIn)->Range(fromJobs, toJobs)->UseRealTime();
+
+static void BM_DependentChain(benchmark::State& state)
+{
+    const auto n = static_cast<std::size_t>(state.range(0));
+    neko::JobScheduler scheduler;
+    const int queueIndex = scheduler.SetupNewQueue(maxWorkers);
+    scheduler.Begin();
+    EmptyJob head;
+    std::vector<std::unique_ptr<EmptyDependentJob>> chain;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        chain.push_back(std::make_unique<EmptyDependentJob>(i == 0 ? static_cast<neko::Job*>(&head) : chain.back().get()));
+    }
+
+    for (auto _ : state)
+    {
+        scheduler.AddJob(&head, queueIndex);
+        for (auto& job : chain)
+        {
+            scheduler.AddJob(job.get(), queueIndex);
+        }
+        chain.back()->Join();
+    }
+    scheduler.End();
+    state.SetItemsProcessed(state.iterations() * static_cast<long>(n + 1));
+}
+
+BENCHMARK(BM_DependentChain)->Range(fromJobs, toJobs)->UseRealTime();
+
+static void BM_WideDependencies(benchmark::State& state)
+{
+    const auto n = static_cast<std::size_t>(state.range(0));
+    neko::JobScheduler scheduler;
+    const int queueIndex = scheduler.SetupNewQueue(maxWorkers);
+    scheduler.Begin();
+    std::vector<neko::Job*> jobPtrs;
+    auto dependencies = MakeJobs<EmptyJob>(n, jobPtrs);
+    EmptyDependenciesJob join;
+    for (auto* dependency : jobPtrs)
+    {
+        join.AddDependency(dependency);
+    }
+
+    for (auto _ : state)
+    {
+        scheduler.AddJobs(jobPtrs, queueIndex);
+        scheduler.AddJob(&join, queueIndex);
+        join.Join();
+    }
+    scheduler.End();
+    state.SetItemsProcessed(state.iterations() * static_cast<long>(n + 1));
+}
+
+BENCHMARK(BM_WideDependencies)->Range(fromJobs, toJobs)->UseRealTime();
+
+/**
+ * \brief BuildLatticeGraph wires n jobs where every job depends on the two previous ones, the shape
+ * with the most upstream paths per job
+ */
+static void BuildLatticeGraph(std::size_t n, neko::DependencyCheck check)
+{
+    std::vector<EmptyDependenciesJob> jobs(n);
+    for (std::size_t i = 2; i < n; i++)
+    {
+        jobs[i].AddDependency(&jobs[i - 1], check);
+        jobs[i].AddDependency(&jobs[i - 2], check);
+    }
+    benchmark::DoNotOptimize(jobs.data());
+}
+
+static void BM_BuildGraphValidated(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        BuildLatticeGraph(static_cast<std::size_t>(state.range(0)), neko::DependencyCheck::Validate);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_BuildGraphValidated)->Range(fromJobs, toJobs);
+
+static void BM_BuildGraphSkipped(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        BuildLatticeGraph(static_cast<std::size_t>(state.range(0)), neko::DependencyCheck::Skip);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_BuildGraphSkipped)->Range(fromJobs, toJobs);
+
+static void BM_ScheduleJobToMainQueue(benchmark::State& state)
+{
+    const auto n = static_cast<std::size_t>(state.range(0));
+    neko::JobScheduler scheduler;
+    const int queueIndex = scheduler.SetupNewQueue(maxWorkers);
+    scheduler.Begin();
+    std::vector<neko::Job*> mainJobPtrs;
+    auto mainJobs = MakeJobs<EmptyJob>(n, mainJobPtrs);
+    std::vector<std::unique_ptr<neko::ScheduleJob>> hops;
+    std::vector<neko::Job*> hopPtrs;
+    for (auto* mainJob : mainJobPtrs)
+    {
+        hops.push_back(std::make_unique<neko::ScheduleJob>(mainJob, neko::MAIN_QUEUE_INDEX));
+        hopPtrs.push_back(hops.back().get());
+    }
+    neko::JobCounter counter;
+
+    for (auto _ : state)
+    {
+        scheduler.AddJobs(hopPtrs, counter, queueIndex);
+        // Once the hops are done every main job is added, ExecuteMainThread then drains them all
+        counter.Wait();
+        scheduler.ExecuteMainThread();
+    }
+    scheduler.End();
+    state.SetItemsProcessed(state.iterations() * static_cast<long>(n));
+}
+
+BENCHMARK(BM_ScheduleJobToMainQueue)->Range(fromJobs, toJobs)->UseRealTime();
+
+static void BM_ScalingJobSystem(benchmark::State& state)
+{
+    constexpr std::size_t n = 1 << 12;
+    neko::JobScheduler scheduler;
+    const int queueIndex = scheduler.SetupNewQueue(static_cast<int>(state.range(0)));
+    scheduler.Begin();
+    std::vector<neko::Job*> jobPtrs;
+    auto jobs = MakeJobs<WorkJob>(n, jobPtrs);
+    neko::JobCounter counter;
+
+    for (auto _ : state)
+    {
+        scheduler.AddJobs(jobPtrs, counter, queueIndex);
+        counter.Wait();
+    }
+    scheduler.End();
+    state.SetItemsProcessed(state.iterations() * static_cast<long>(n));
+}
+
+BENCHMARK(BM_ScalingJobSystem)->RangeMultiplier(2)->Range(1, maxWorkers)->UseRealTime();
+
+static void BM_ScalingWorkStealing(benchmark::State& state)
+{
+    constexpr std::size_t n = 1 << 12;
+    neko::JobScheduler scheduler;
+    const int queueIndex = scheduler.SetupNewQueue(static_cast<int>(state.range(0)), neko::QueueMode::WorkStealing);
+    scheduler.Begin();
+    std::vector<neko::Job*> jobPtrs;
+    auto jobs = MakeJobs<WorkJob>(n, jobPtrs);
+    neko::JobCounter counter;
+
+    for (auto _ : state)
+    {
+        scheduler.AddJobs(jobPtrs, counter, queueIndex);
+        counter.Wait();
+    }
+    scheduler.End();
+    state.SetItemsProcessed(state.iterations() * static_cast<long>(n));
+}
+
+BENCHMARK(BM_ScalingWorkStealing)->RangeMultiplier(2)->Range(1, maxWorkers)->UseRealTime();
+
+static void BM_ScalingRawThreadPool(benchmark::State& state)
+{
+    constexpr std::size_t n = 1 << 12;
+    RawThreadPool pool{static_cast<int>(state.range(0))};
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < n; i++)
+        {
+            pool.Push(DoWork);
+        }
+        pool.Wait();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<long>(n));
+}
+
+BENCHMARK(BM_ScalingRawThreadPool)->RangeMultiplier(2)->Range(1, maxWorkers)->UseRealTime();
+
+static void BM_EmptyRawThreadPool(benchmark::State& state)
+{
+    const auto n = state.range(0);
+    RawThreadPool pool{maxWorkers};
+
+    for (auto _ : state)
+    {
+        for (long i = 0; i < n; i++)
+        {
+            pool.Push([] {});
+        }
+        pool.Wait();
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+BENCHMARK(BM_EmptyRawThreadPool)->Range(fromJobs, toJobs)->UseRealTime();
+
+static void BM_EmptyStdAsync(benchmark::State& state)
+{
+    // One thread per task, the number is kept low
+    const auto n = static_cast<std::size_t>(state.range(0));
+    std::vector<std::future<void>> futures;
+    futures.reserve(n);
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < n; i++)
+        {
+            futures.push_back(std::async(std::launch::async, [] {}));
+        }
+        for (auto& future : futures)
+        {
+            future.wait();
+        }
+        futures.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_EmptyStdAsync)->Range(fromJobs, 1 << 8)->UseRealTime();
+
+static void BM_WorkStdAsync(benchmark::State& state)
+{
+    // Same work as the scaling benchmarks, split in one task per worker since std::async spawns threads
+    constexpr std::size_t n = 1 << 12;
+    const auto taskCount = static_cast<std::size_t>(state.range(0));
+    std::vector<std::future<void>> futures;
+    futures.reserve(taskCount);
+
+    for (auto _ : state)
+    {
+        for (std::size_t task = 0; task < taskCount; task++)
+        {
+            const auto begin = n * task / taskCount;
+            const auto end = n * (task + 1) / taskCount;
+            futures.push_back(std::async(std::launch::async, [begin, end]
+            {
+                for (auto i = begin; i < end; i++)
+                {
+                    DoWork();
+                }
+            }));
+        }
+        for (auto& future : futures)
+        {
+            future.wait();
+        }
+        futures.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<long>(n));
+}
+
+BENCHMARK(BM_WorkStdAsync)->RangeMultiplier(2)->Range(1, maxWorkers)->UseRealTime();
+
+BENCHMARK_MAIN();
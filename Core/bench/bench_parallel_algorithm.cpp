@@ -0,0 +1,231 @@
+#include "thread/parallel_algorithm.h"
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+const long fromRange = 1 << 10;
+const long toRange = 1 << 22;
+
+/**
+ * \brief BenchQueue starts the default scheduler with one worker per hardware thread on first use,
+ * and ends it when the benchmark exits
+ */
+class BenchQueue
+{
+public:
+    BenchQueue()
+    {
+        queueIndex_ = neko::JobSystem::SetupNewQueue(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+        neko::JobSystem::Begin();
+    }
+    ~BenchQueue()
+    {
+        neko::JobSystem::End();
+    }
+    static int Get()
+    {
+        static BenchQueue queue;
+        return queue.queueIndex_;
+    }
+private:
+    int queueIndex_ = 0;
+};
+
+std::vector<int> MakeRandomValues(std::size_t size)
+{
+    std::mt19937 generator{42};
+    std::uniform_int_distribution distribution{0, 1 << 20};
+    std::vector<int> values(size);
+    for (auto& value : values)
+    {
+        value = distribution(generator);
+    }
+    return values;
+}
+}
+
+static void BM_SortStd(benchmark::State& state)
+{
+    const auto original = MakeRandomValues(static_cast<std::size_t>(state.range(0)));
+    std::vector<int> values;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        values = original;
+        state.ResumeTiming();
+        std::sort(values.begin(), values.end());
+        benchmark::DoNotOptimize(values.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_SortStd)->Range(fromRange, toRange)->UseRealTime();
+
+static void BM_SortParallel(benchmark::State& state)
+{
+    const int queueIndex = BenchQueue::Get();
+    const auto original = MakeRandomValues(static_cast<std::size_t>(state.range(0)));
+    std::vector<int> values;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        values = original;
+        state.ResumeTiming();
+        neko::Parallel::Sort(values, queueIndex);
+        benchmark::DoNotOptimize(values.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_SortParallel)->Range(fromRange, toRange)->UseRealTime();
+
+static void BM_ReduceStd(benchmark::State& state)
+{
+    const auto values = MakeRandomValues(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(std::reduce(values.begin(), values.end(), 0LL));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_ReduceStd)->Range(fromRange, toRange)->UseRealTime();
+
+static void BM_ReduceParallel(benchmark::State& state)
+{
+    const int queueIndex = BenchQueue::Get();
+    const auto values = MakeRandomValues(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(neko::Parallel::Reduce(values, 0LL, queueIndex));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_ReduceParallel)->Range(fromRange, toRange)->UseRealTime();
+
+static void BM_TransformReduceStd(benchmark::State& state)
+{
+    const auto values = MakeRandomValues(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(std::transform_reduce(values.begin(), values.end(), 0LL, std::plus<>{},
+            [](int value) { return static_cast<long long>(value) * value; }));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_TransformReduceStd)->Range(fromRange, toRange)->UseRealTime();
+
+static void BM_TransformReduceParallel(benchmark::State& state)
+{
+    const int queueIndex = BenchQueue::Get();
+    const auto values = MakeRandomValues(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(neko::Parallel::TransformReduce(values, 0LL, std::plus<>{},
+            [](int value) { return static_cast<long long>(value) * value; }, queueIndex));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_TransformReduceParallel)->Range(fromRange, toRange)->UseRealTime();
+
+static void BM_InclusiveScanStd(benchmark::State& state)
+{
+    const auto values = MakeRandomValues(static_cast<std::size_t>(state.range(0)));
+    std::vector<int> output(values.size());
+    for (auto _ : state)
+    {
+        std::inclusive_scan(values.begin(), values.end(), output.begin());
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_InclusiveScanStd)->Range(fromRange, toRange)->UseRealTime();
+
+static void BM_InclusiveScanParallel(benchmark::State& state)
+{
+    const int queueIndex = BenchQueue::Get();
+    const auto values = MakeRandomValues(static_cast<std::size_t>(state.range(0)));
+    std::vector<int> output(values.size());
+    for (auto _ : state)
+    {
+        neko::Parallel::InclusiveScan(values, output, queueIndex);
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_InclusiveScanParallel)->Range(fromRange, toRange)->UseRealTime();
+
+static void BM_ForEachStd(benchmark::State& state)
+{
+    auto values = MakeRandomValues(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state)
+    {
+        std::for_each(values.begin(), values.end(), [](int& value) { value = value * 3 + 1; });
+        benchmark::DoNotOptimize(values.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_ForEachStd)->Range(fromRange, toRange)->UseRealTime();
+
+static void BM_ForEachParallel(benchmark::State& state)
+{
+    const int queueIndex = BenchQueue::Get();
+    auto values = MakeRandomValues(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state)
+    {
+        neko::Parallel::ForEach(values, [](int& value) { value = value * 3 + 1; }, queueIndex);
+        benchmark::DoNotOptimize(values.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_ForEachParallel)->Range(fromRange, toRange)->UseRealTime();
+
+static void BM_PartitionStd(benchmark::State& state)
+{
+    const auto original = MakeRandomValues(static_cast<std::size_t>(state.range(0)));
+    std::vector<int> values;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        values = original;
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(std::stable_partition(values.begin(), values.end(),
+            [](int value) { return value % 2 == 0; }));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_PartitionStd)->Range(fromRange, toRange)->UseRealTime();
+
+static void BM_PartitionParallel(benchmark::State& state)
+{
+    const int queueIndex = BenchQueue::Get();
+    const auto original = MakeRandomValues(static_cast<std::size_t>(state.range(0)));
+    std::vector<int> values;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        values = original;
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(neko::Parallel::Partition(values, [](int value) { return value % 2 == 0; },
+            queueIndex));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_PartitionParallel)->Range(fromRange, toRange)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,116 @@
+#include "thread/pipeline.h"
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+const long fromItems = 1 << 8;
+const long toItems = 1 << 14;
+const int workerCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+// Busy work of a stage, roughly a microsecond
+constexpr int workIterations = 256;
+
+std::uint32_t DoWork(std::uint32_t value)
+{
+    for (int i = 0; i < workIterations; i++)
+    {
+        value = value * 1664525u + 1013904223u;
+        benchmark::DoNotOptimize(value);
+    }
+    return value;
+}
+
+struct Item
+{
+    std::uint32_t value = 0;
+};
+
+class DecodeJob : public neko::Job
+{
+public:
+    Item item;
+protected:
+    void ExecuteImpl() override { item.value = DoWork(item.value); }
+};
+
+class TransformJob : public neko::DependentJob
+{
+public:
+    TransformJob(Job* dependency, Item& item) : DependentJob(dependency), item_(item) {}
+protected:
+    void ExecuteImpl() override { item_.value = DoWork(item_.value); }
+private:
+    Item& item_;
+};
+}
+
+static void BM_DependentJobChains(benchmark::State& state)
+{
+    const auto itemCount = static_cast<std::size_t>(state.range(0));
+    neko::JobScheduler scheduler;
+    const int queueIndex = scheduler.SetupNewQueue(workerCount);
+    scheduler.Begin();
+    std::uint32_t checksum = 0;
+    for (auto _ : state)
+    {
+        // The hand-made version: a job per item per stage, then a serial pass in order
+        std::vector<std::unique_ptr<DecodeJob>> decodeJobs;
+        std::vector<std::unique_ptr<TransformJob>> transformJobs;
+        for (std::size_t i = 0; i < itemCount; i++)
+        {
+            auto& decodeJob = decodeJobs.emplace_back(std::make_unique<DecodeJob>());
+            decodeJob->item.value = static_cast<std::uint32_t>(i);
+            auto& transformJob = transformJobs.emplace_back(std::make_unique<TransformJob>(decodeJob.get(), decodeJob->item));
+            scheduler.AddJob(decodeJob.get(), queueIndex);
+            scheduler.AddJob(transformJob.get(), queueIndex);
+        }
+        for (std::size_t i = 0; i < itemCount; i++)
+        {
+            transformJobs[i]->Join();
+            checksum += decodeJobs[i]->item.value;
+        }
+    }
+    scheduler.End();
+    benchmark::DoNotOptimize(checksum);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_DependentJobChains)->Range(fromItems, toItems)->UseRealTime();
+
+static void BM_Pipeline(benchmark::State& state)
+{
+    const auto itemCount = static_cast<std::uint32_t>(state.range(0));
+    neko::JobScheduler scheduler;
+    const int queueIndex = scheduler.SetupNewQueue(workerCount);
+    scheduler.Begin();
+    std::uint32_t nextItem = 0;
+    std::uint32_t checksum = 0;
+    neko::Pipeline<Item> pipeline(static_cast<std::size_t>(workerCount) * 2, [&nextItem, itemCount](Item& item)
+    {
+        if (nextItem == itemCount)
+        {
+            return false;
+        }
+        item.value = nextItem++;
+        return true;
+    });
+    pipeline.AddStage(neko::StageMode::Parallel, [](Item& item) { item.value = DoWork(item.value); })
+        .AddStage(neko::StageMode::Parallel, [](Item& item) { item.value = DoWork(item.value); })
+        .AddStage(neko::StageMode::SerialInOrder, [&checksum](Item& item) { checksum += item.value; });
+    for (auto _ : state)
+    {
+        nextItem = 0;
+        pipeline.Run(queueIndex, scheduler);
+    }
+    scheduler.End();
+    benchmark::DoNotOptimize(checksum);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_Pipeline)->Range(fromItems, toItems)->UseRealTime();
+
+BENCHMARK_MAIN();
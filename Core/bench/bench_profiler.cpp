@@ -0,0 +1,55 @@
+#include "utils/profiler.h"
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+
+static void BM_ProfilerEmpty(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        benchmark::ClobberMemory();
+    }
+}
+
+BENCHMARK(BM_ProfilerEmpty);
+
+static void BM_ProfilerScopedZone(benchmark::State& state)
+{
+    neko::Profiler::Clear();
+    std::size_t count = 0;
+    for (auto _ : state)
+    {
+        neko::Profiler::ScopedZone zone("Zone");
+        benchmark::ClobberMemory();
+        // Drained outside of the timing, so that the ring never fills
+        if (++count == neko::Profiler::ThreadBuffer::CAPACITY / 2)
+        {
+            state.PauseTiming();
+            neko::Profiler::Clear();
+            count = 0;
+            state.ResumeTiming();
+        }
+    }
+}
+
+BENCHMARK(BM_ProfilerScopedZone);
+
+static void BM_ProfilerWriteChromeTrace(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        for (long i = 0; i < state.range(0); i++)
+        {
+            neko::Profiler::ScopedZone zone("Zone");
+        }
+        std::ostringstream out;
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(neko::Profiler::WriteChromeTrace(out));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_ProfilerWriteChromeTrace)->Range(1 << 6, 1 << 13);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,111 @@
+#ifndef NEKOLIB_COROUTINE_JOB_H
+#define NEKOLIB_COROUTINE_JOB_H
+
+#include "thread/job_system.h"
+
+#include <coroutine>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace neko
+{
+
+class CoroutineJob;
+
+/**
+ * \brief JobTask is the return type of a coroutine run by a CoroutineJob. Its body can co_await a Job&
+ * or a group of jobs (std::span<Job* const>): instead of blocking the
+ * worker in Join, the coroutine is suspended and the CoroutineJob dispatched again on its queue
+ * once they are all done. The awaited jobs must be added to the JobSystem by someone else.
+ */
+class JobTask
+{
+public:
+    class promise_type;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    JobTask(JobTask&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    JobTask& operator=(JobTask&& other) noexcept;
+    JobTask(const JobTask&) = delete;
+    JobTask& operator=(const JobTask&) = delete;
+    ~JobTask();
+private:
+    friend class CoroutineJob;
+    explicit JobTask(Handle handle) : handle_(handle) {}
+    Handle handle_;
+};
+
+/**
+ * \brief CoroutineJob runs a JobTask coroutine. It is a one-shot job: once the coroutine returned, adding
+ * the job again only marks it as failed.
+ */
+class CoroutineJob : public Job
+{
+public:
+    explicit CoroutineJob(JobTask task);
+    void Execute() override;
+protected:
+    void ExecuteImpl() override {}
+private:
+    friend class JobTask::promise_type;
+    class JobAwaiter;
+    class JobsAwaiter;
+    class FinalAwaiter;
+
+    void Finish(bool failed);
+
+    JobTask task_;
+};
+
+class CoroutineJob::JobAwaiter
+{
+public:
+    JobAwaiter(CoroutineJob* self, Job& job) : self_(self), link_{&job, self} {}
+    [[nodiscard]] bool await_ready() const { return link_.dependency->IsDone(); }
+    bool await_suspend(std::coroutine_handle<>) { return self_->WaitForDependencies({&link_, 1}); }
+    void await_resume() const {}
+private:
+    CoroutineJob* self_;
+    DependencyLink link_;
+};
+
+class CoroutineJob::JobsAwaiter
+{
+public:
+    JobsAwaiter(CoroutineJob* self, std::span<Job* const> jobs);
+    [[nodiscard]] bool await_ready() const;
+    bool await_suspend(std::coroutine_handle<>) { return self_->WaitForDependencies(links_); }
+    void await_resume() const {}
+private:
+    CoroutineJob* self_;
+    std::vector<DependencyLink> links_;
+};
+
+class CoroutineJob::FinalAwaiter
+{
+public:
+    [[nodiscard]] bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<JobTask::promise_type> handle) noexcept;
+    void await_resume() const noexcept {}
+};
+
+class JobTask::promise_type
+{
+public:
+    JobTask get_return_object() { return JobTask{Handle::from_promise(*this)}; }
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    CoroutineJob::FinalAwaiter final_suspend() const noexcept { return {}; }
+    void return_void() const {}
+    void unhandled_exception() { failed_ = true; }
+
+    CoroutineJob::JobAwaiter await_transform(Job& job) { return {job_, job}; }
+    CoroutineJob::JobsAwaiter await_transform(std::span<Job* const> jobs) { return {job_, jobs}; }
+private:
+    friend class CoroutineJob;
+    CoroutineJob* job_ = nullptr;
+    bool failed_ = false;
+};
+
+}
+#endif //NEKOLIB_COROUTINE_JOB_H
@@ -0,0 +1,107 @@
+#ifndef NEKOLIB_CPU_TOPOLOGY_H
+#define NEKOLIB_CPU_TOPOLOGY_H
+
+#include <string_view>
+#include <vector>
+
+namespace neko
+{
+
+struct CpuInfo
+{
+    int cpu = 0;
+    int package = 0;
+    // Physical core, unique across packages: SMT siblings share it
+    int core = 0;
+    // Smallest logical cpu sharing the same last level (L3) cache
+    int cacheDomain = 0;
+    int numaNode = 0;
+};
+
+/**
+ * \brief CpuTopology lists the online logical cpus with their package, physical core, L3 domain and
+ * NUMA node. On Linux it is read from /sys/devices/system/cpu, elsewhere every hardware thread is
+ * reported as its own core in a single domain.
+ */
+class CpuTopology
+{
+public:
+    CpuTopology() = default;
+    explicit CpuTopology(std::vector<CpuInfo> cpus);
+
+    /**
+     * \brief Get reads the topology of this machine once and caches it
+     */
+    static const CpuTopology& Get();
+    static CpuTopology Read();
+
+    [[nodiscard]] const std::vector<CpuInfo>& GetCpus() const { return cpus_; }
+    /**
+     * \brief GetPhysicalCores returns the first logical cpu of every physical core, ordered by package
+     */
+    [[nodiscard]] std::vector<int> GetPhysicalCores() const;
+    [[nodiscard]] std::vector<int> GetCacheDomainCpus(int cacheDomain) const;
+    [[nodiscard]] std::vector<int> GetNumaNodeCpus(int numaNode) const;
+
+    /**
+     * \brief ParseCpuList parses the kernel cpu list format, like "0-3,8,10-11"
+     */
+    static std::vector<int> ParseCpuList(std::string_view cpuList);
+private:
+    std::vector<CpuInfo> cpus_;
+};
+
+/**
+ * \brief AffinityPolicy tells SetupNewQueue where to pin the workers of a queue.
+ */
+class AffinityPolicy
+{
+public:
+    /**
+     * \brief None leaves the workers to the OS scheduler, the default
+     */
+    static AffinityPolicy None() { return {}; }
+    /**
+     * \brief CpuSets pins worker i to cpuSets[i % cpuSets.size()]
+     */
+    static AffinityPolicy CpuSets(std::vector<std::vector<int>> cpuSets);
+    /**
+     * \brief PhysicalCores pins one worker per physical core (on its first SMT sibling), wrapping
+     * around when there are more workers than cores
+     */
+    static AffinityPolicy PhysicalCores();
+    /**
+     * \brief CacheDomain keeps all the workers within the cpus sharing the L3 cache of cpu
+     */
+    static AffinityPolicy CacheDomain(int cpu = 0);
+    /**
+     * \brief NumaNode keeps all the workers within the cpus of a NUMA node
+     */
+    static AffinityPolicy NumaNode(int numaNode = 0);
+
+    /**
+     * \brief Assign returns the cpu set of each worker, empty sets meaning no affinity
+     */
+    [[nodiscard]] std::vector<std::vector<int>> Assign(const CpuTopology& topology, int threadCount) const;
+private:
+    enum class Type
+    {
+        None,
+        CpuSets,
+        PhysicalCores,
+        CacheDomain,
+        NumaNode
+    };
+    Type type_ = Type::None;
+    int domain_ = 0;
+    std::vector<std::vector<int>> cpuSets_;
+};
+
+/**
+ * \brief SetCurrentThreadAffinity pins the calling thread to cpus
+ * @return false if it is not supported on this platform or was refused
+ */
+bool SetCurrentThreadAffinity(const std::vector<int>& cpus);
+
+}
+#endif //NEKOLIB_CPU_TOPOLOGY_H
@@ -0,0 +1,64 @@
+#ifndef NEKOLIB_DURATION_HISTORY_H
+#define NEKOLIB_DURATION_HISTORY_H
+
+#include "thread/job_system.h"
+
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace neko
+{
+
+/**
+ * \brief DurationHistory keeps an exponential moving average of the execution time per DurationKey, in a
+ * fixed open addressing table updated without locks by the threads executing the jobs. Keys past the
+ * capacity (or too many colliding ones) are not recorded, their expected duration stays zero.
+ */
+class DurationHistory
+{
+public:
+    static constexpr std::size_t CAPACITY = 1u << 12;
+    static constexpr std::size_t MAX_PROBE_COUNT = 32;
+    // Each sample moves the average by 1/2^SMOOTHING_SHIFT of the difference
+    static constexpr int SMOOTHING_SHIFT = 3;
+
+    DurationHistory();
+
+    void Record(DurationKey key, std::chrono::nanoseconds duration);
+    /**
+     * @brief GetExpectedDuration is the moving average of key, zero when it has no sample
+     */
+    [[nodiscard]] std::chrono::nanoseconds GetExpectedDuration(DurationKey key) const;
+    [[nodiscard]] std::vector<DurationRecord> Export() const;
+    /**
+     * @brief Import replaces the averages of the keys of records, the other keys are kept
+     */
+    void Import(std::span<const DurationRecord> records);
+    /**
+     * @brief Clear forgets every key, it must not race with Record
+     */
+    void Clear();
+private:
+    // Average of a key without sample yet, the first sample replaces it instead of moving it
+    static constexpr std::int64_t EMPTY_AVERAGE = std::numeric_limits<std::int64_t>::min();
+
+    struct Entry
+    {
+        std::atomic<DurationKey> key{ NO_DURATION_KEY };
+        std::atomic<std::int64_t> average{ EMPTY_AVERAGE };
+        std::atomic<std::uint64_t> sampleCount{ 0 };
+    };
+
+    [[nodiscard]] const Entry* Find(DurationKey key) const;
+    Entry* FindOrInsert(DurationKey key);
+    [[nodiscard]] static std::size_t GetSlot(DurationKey key);
+
+    std::unique_ptr<Entry[]> entries_;
+};
+
+}
+#endif //NEKOLIB_DURATION_HISTORY_H
@@ -0,0 +1,128 @@
+#ifndef NEKOLIB_JOB_GRAPH_H
+#define NEKOLIB_JOB_GRAPH_H
+
+#include "thread/job_system.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace neko
+{
+
+/**
+ * \brief JobGraph is a static graph of jobs, built once and run every frame.
+ * Nodes and edges are added first, then Compile validates the graph and precomputes the topological
+ * levels, the predecessor count of every node and the root nodes per queue. Run only starts a new run
+ * number and enqueues the roots in bulk: the per node counters count up across runs and are never
+ * reset, a node being ready once the last of its predecessors of this run finished. That predecessor
+ * runs it next on the same thread when it is on the same queue, and adds it otherwise. A node whose
+ * predecessor failed is skipped as failed, like a DependentJob. A node job is reset when it starts,
+ * it reports the previous run until then. A CoroutineJob node suspended on a co_await resumes on its
+ * node queue, and its successors only start once its coroutine is done.
+ *
+ * The node jobs must not have dependencies of their own, the edges replace them.
+ * Like with ScheduleJob, nodes on the main queue are dispatched when ready: the main thread must keep
+ * calling ExecuteMainThread until the graph is done, or Join it.
+ */
+class JobGraph
+{
+public:
+    using NodeIndex = std::size_t;
+
+    JobGraph() = default;
+    JobGraph(const JobGraph&) = delete;
+    JobGraph& operator=(const JobGraph&) = delete;
+
+    /**
+     * @throw std::logic_error while a run is not done, like AddEdge
+     */
+    NodeIndex AddNode(Job* job, int queueIndex = MAIN_QUEUE_INDEX);
+    /**
+     * @brief AddEdge makes the node to depend on the node from
+     * @throw std::out_of_range if from or to is not a node of the graph
+     */
+    void AddEdge(NodeIndex from, NodeIndex to);
+    /**
+     * @brief Compile must be called after the last AddNode/AddEdge and before Run
+     * @return false if the graph has a cycle, it cannot be run then, or if a run is not done yet and
+     * the previous compilation is kept
+     */
+    bool Compile();
+    /**
+     * @brief Run starts the graph on scheduler
+     * @throw std::logic_error if the previous run is not done yet
+     */
+    void Run(JobScheduler& scheduler = JobSystem::GetScheduler());
+    void Join() const;
+    [[nodiscard]] bool IsDone() const { return isDone_.load(std::memory_order_acquire); }
+    [[nodiscard]] bool HasFailed() const { return hasFailed_.load(std::memory_order_acquire); }
+    [[nodiscard]] std::size_t GetNodeCount() const { return nodes_.size(); }
+    /**
+     * @brief GetLevel is the length of the longest path from a root to the node, valid after Compile
+     */
+    [[nodiscard]] std::size_t GetLevel(NodeIndex node) const { return nodes_[node].level; }
+private:
+    class NodeJob : public Job
+    {
+    public:
+        void Execute() override;
+    protected:
+        void ExecuteImpl() override {}
+    private:
+        friend class JobGraph;
+        JobGraph* graph_ = nullptr;
+        NodeIndex index_ = 0;
+        // Set while the job of the node is suspended, this one is dispatched again once it is done
+        DependencyLink completion_{};
+        bool isResumed_ = false;
+    };
+    struct Node
+    {
+        Job* job = nullptr;
+        int queueIndex = MAIN_QUEUE_INDEX;
+        std::size_t level = 0;
+        int predecessorCount = 0;
+        // Range of this node successors in successors_
+        std::size_t successorsBegin = 0;
+        std::size_t successorsEnd = 0;
+    };
+    struct RootBatch
+    {
+        int queueIndex = MAIN_QUEUE_INDEX;
+        std::vector<Job*> jobs;
+    };
+
+    /**
+     * @param isResumed the node job was suspended and is done now, only its successors are left
+     */
+    void ExecuteNode(NodeIndex index, bool isResumed = false);
+    /**
+     * @return true if the node job is still suspended, the node is executed again once it is done
+     */
+    bool WaitForNode(NodeIndex index);
+    void DispatchNode(NodeIndex index);
+
+    std::vector<Node> nodes_;
+    std::vector<std::pair<NodeIndex, NodeIndex>> edges_;
+    std::vector<NodeIndex> successors_;
+    std::vector<RootBatch> roots_;
+    // Main queue nodes that are not roots, reserved as pending main thread jobs by Run until dispatched
+    int mainSuccessorCount_ = 0;
+    std::unique_ptr<NodeJob[]> nodeJobs_;
+    // Predecessors finished over all the runs, a node is ready at run_ times its predecessor count
+    std::unique_ptr<std::atomic<std::uint64_t>[]> finishedPredecessors_;
+    // Last run in which a predecessor of the node failed
+    std::unique_ptr<std::atomic<std::uint64_t>[]> failedRun_;
+    // Written by Run only, published to the nodes with the enqueue of the roots
+    std::uint64_t run_ = 0;
+    std::atomic<std::size_t> remainingNodes_{0};
+    std::atomic<bool> isDone_{true};
+    std::atomic<bool> hasFailed_{false};
+    bool isCompiled_ = false;
+    // Set by Run, the successors are added there too
+    JobScheduler* scheduler_ = nullptr;
+};
+
+}
+#endif //NEKOLIB_JOB_GRAPH_H
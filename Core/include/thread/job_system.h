@@ -5,13 +5,77 @@
 #include <atomic>
 #include <functional>
 #include <memory>
-#include <future>
+#include <optional>
+#include <exception>
+#include <stdexcept>
 #include <array>
 #include <algorithm>
+#include <span>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <bit>
+#include <chrono>
+#include <limits>
 
 namespace neko
 {
 
+static constexpr auto MAIN_QUEUE_INDEX = -1;
+static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * \brief TimerId identifies a pending timer of JobScheduler::AddJobAfter or AddPeriodicJob
+ */
+using TimerId = std::uint64_t;
+static constexpr TimerId INVALID_TIMER_ID = 0;
+
+/**
+ * \brief DurationKey groups the jobs whose execution time is recorded together, see Job::SetDurationKey
+ */
+using DurationKey = std::uint32_t;
+static constexpr DurationKey NO_DURATION_KEY = 0;
+
+/**
+ * \brief DurationRecord is the recorded execution time of a DurationKey, see JobScheduler::ExportDurationHistory
+ */
+struct DurationRecord
+{
+    DurationKey key = NO_DURATION_KEY;
+    std::chrono::nanoseconds average{ 0 };
+    std::uint64_t sampleCount = 0;
+};
+
+/**
+ * \brief JobPriority is the lane of its queue a job is added to. Workers always drain the higher
+ * lanes first, see JobSystem::SetPriorityAging to keep the lower ones from starving.
+ */
+enum class JobPriority
+{
+    High,
+    Normal,
+    Low
+};
+static constexpr std::size_t JOB_PRIORITY_COUNT = 3;
+
+/**
+ * \brief DependencyCheck tells AddDependency whether to look for a cycle first. Skip is for graphs
+ * already verified offline, or built in an order that cannot close one.
+ */
+enum class DependencyCheck
+{
+    Validate,
+    Skip
+};
+
+class Job;
+class JobCounter;
+
+class JobScheduler;
+class JobSchedulerState;
+
 class Job
 {
 public:
@@ -24,81 +88,238 @@ public:
     [[nodiscard]] bool IsCancelled() const;
     [[nodiscard]] virtual bool ShouldStart() const;
     void Reset();
+    /**
+     * \brief Join waits for the job to be done. Called from a worker, or from the thread that called
+     * JobSystem::Begin, it first executes other ready jobs of the caller's own queue, see
+     * JobSystem::HelpWhileWaiting.
+     */
     void Join() const;
     void SetCancelFlag(std::atomic<bool>* flag) { cancelFlag_ = flag; }
+    /**
+     * \brief SetCounter makes this job decrement counter every time it is done, whether it ran, failed
+     * or was skipped. It must be set before the job is added.
+     */
+    void SetCounter(JobCounter* counter) { counter_ = counter; }
+    [[nodiscard]] JobPriority GetPriority() const { return priority_; }
+    /**
+     * \brief SetDurationKey makes the scheduler record the execution time of this job under key, and start
+     * the longest expected jobs first in the batches of AddJobs. NO_DURATION_KEY records nothing.
+     */
+    void SetDurationKey(DurationKey key) { durationKey_ = key; }
+    [[nodiscard]] DurationKey GetDurationKey() const { return durationKey_; }
+    /**
+     * \brief GetScheduler is the scheduler the job was last added to, null before
+     */
+    [[nodiscard]] JobScheduler* GetScheduler() const { return scheduler_; }
 
     /**
-     * \brief CheckDependency is a member function used to check if the arg ptr is already a dependency
+     * \brief CheckDependency is a member function used to check if the arg ptr is already a dependency.
+     * It walks the dependency links upstream, visiting each job at most once per call.
      * @param ptr
-     * @return false if not a dependency
+     * @return false if ptr is neither this job nor one of its direct or indirect dependencies
      */
     virtual bool CheckDependency(const Job* ptr) const;
 
 protected:
+    /**
+     * \brief DependencyLink is one edge of the job graph, owned by the dependent job.
+     * When the dependent job is added to the JobSystem, its links are pushed on the continuation
+     * list of their dependency, which releases them once done. The link storage must therefore not
+     * move while the dependent job is in flight.
+     */
+    struct DependencyLink
+    {
+        Job* dependency = nullptr;
+        Job* dependent = nullptr;
+        DependencyLink* next = nullptr;
+    };
+    /**
+     * \brief GetDependencyLinks is overridden by the job types with dependencies, links with a null
+     * dependency are ignored
+     */
+    virtual std::span<DependencyLink> GetDependencyLinks() { return {}; }
+    /**
+     * \brief WaitForDependencies dispatches this job again on its queue, once every dependency of
+     * links is done. It is meant for jobs suspending in the middle of their execution.
+     * @return false if they all already are, the job is then not dispatched
+     */
+    bool WaitForDependencies(std::span<DependencyLink> links);
+    /**
+     * \brief GetSchedulerOrDefault is the scheduler of the job, or the default one for a job never added,
+     * like a graph node or a job executed directly
+     */
+    [[nodiscard]] JobScheduler& GetSchedulerOrDefault() const;
+
     virtual void ExecuteImpl() = 0;
     void SkipAsFailed();
     void MarkStarted();
-    void MarkDone();
+    /**
+     * \brief MarkDone publishes the end of the job, failed or not, in a single update of its state
+     */
+    void MarkDone(bool hasFailed = false);
     void MarkFailed();
 private:
-    std::atomic<bool> hasStarted_{ false };
-    std::atomic<bool> isDone_{ false };
-    std::atomic<bool> failed_{ false };
+    /**
+     * \brief StateFlag are the bits of state_. The whole lifecycle lives in this one word, so that each
+     * transition is a single atomic operation, and Join waits on it.
+     */
+    enum StateFlag : std::uint32_t
+    {
+        PENDING = 0,
+        STARTED = 1u << 0,
+        FAILED = 1u << 1,
+        CANCELLED = 1u << 2,
+        DONE = 1u << 3,
+        // Set by a thread about to wait, so that finishing only notifies when someone waits
+        WAITING = 1u << 4
+    };
+    void Complete(std::uint32_t flags);
+
+    friend class JobSchedulerState;
+    friend class JobGraph;
+    friend class JobCounter;
+    friend class ThreadCounters;
+    /**
+     * \brief AddContinuation pushes the link on this job continuation list
+     * @return false if this job is already done, the link is then not pushed
+     */
+    bool AddContinuation(DependencyLink* link);
+    /**
+     * \brief ArmDependencies registers the links on their dependencies
+     * @return true if they are all already done, the job must then be dispatched by the caller
+     */
+    bool ArmDependencies(std::span<DependencyLink> links);
+    /**
+     * \brief ReleaseDependency is called once per finished dependency
+     * @return true if it was the last one, the job must then be enqueued by the caller
+     */
+    bool ReleaseDependency();
+    static void ReleaseContinuations(DependencyLink* continuations);
+
+    static DependencyLink closedContinuations_;
+    static std::atomic<std::uint64_t> visitEpoch_;
+
+    // The completion path only touches these two, kept side by side. Mutable for the WAITING bit of Join.
+    mutable std::atomic<std::uint32_t> state_{ PENDING };
+    // Intrusive stack of the jobs waiting on this one, closed with closedContinuations_ when done
+    std::atomic<DependencyLink*> continuations_{ nullptr };
     std::atomic<bool>* cancelFlag_{ nullptr };
+    // Unfinished dependencies, plus one held by AddJob while it registers the links
+    std::atomic<int> pendingDependencies_{ 0 };
+    JobScheduler* scheduler_ = nullptr;
+    int queueIndex_ = MAIN_QUEUE_INDEX;
+    JobPriority priority_ = JobPriority::Normal;
+    DurationKey durationKey_ = NO_DURATION_KEY;
+    // steady_clock time in nanoseconds at which the job was last enqueued, for the start latency
+    std::int64_t readyTime_ = 0;
+    JobCounter* counter_ = nullptr;
+    // Epoch of the last CheckDependency walk that reached this job
+    mutable std::atomic<std::uint64_t> visitMark_{ 0 };
 };
 
+/**
+ * \brief JobCounter is a wait group: it is done once the jobs counted in it are all done. Waiting on
+ * it costs a single wake-up for the whole group instead of one Join per job, and it can be the
+ * dependency of other jobs (DependentJob, DependenciesJob...) to fan in a group.
+ * It is never added to the JobSystem itself. Add must not race with the last Decrement: count the next
+ * group once the previous one is done, or while it still has jobs in flight.
+ */
+class JobCounter final : public Job
+{
+public:
+    explicit JobCounter(int count = 0);
+    /**
+     * \brief Add counts count more jobs, reopening the counter if it was done
+     */
+    void Add(int count = 1);
+    /**
+     * \brief Decrement is called by the counted jobs when done (see Job::SetCounter)
+     */
+    void Decrement();
+    [[nodiscard]] int GetCount() const { return count_.load(std::memory_order_acquire); }
+    /**
+     * \brief SetScheduler is the scheduler Wait helps, for counters of jobs not added through
+     * JobScheduler::AddJobs with this counter, which sets it already
+     */
+    void SetScheduler(JobScheduler* scheduler) { scheduler_ = scheduler; }
+    void Wait() const { Join(); }
+protected:
+    void ExecuteImpl() override {}
+private:
+    std::atomic<int> count_{0};
+};
+
+/**
+ * \brief CacheAlignedJob gives a job type its own cache lines, for jobs stored side by side in an array
+ * and finished by different workers: without it, the state of neighbour jobs false-share.
+ */
+template<typename JobType>
+class alignas(CACHE_LINE_SIZE) CacheAlignedJob final : public JobType
+{
+    static_assert(std::is_base_of_v<Job, JobType>, "CacheAlignedJob needs a Job type");
+public:
+    using JobType::JobType;
+};
 
 class DependentJob : public Job
 {
 public:
-    DependentJob(Job* dependency) : dependency_(dependency)
+    DependentJob(Job* dependency) : dependency_{dependency, this}
     {
 
     }
     void Execute() override;
     [[nodiscard]] bool ShouldStart() const override;
-	[[nodiscard]] bool CheckDependency(const Job *ptr) const override;
+protected:
+    std::span<DependencyLink> GetDependencyLinks() override { return {&dependency_, 1}; }
 private:
-    Job* dependency_{};
+    DependencyLink dependency_{};
 };
 
 class DependenciesJob: public Job
 {
 public:
     DependenciesJob() = default;
-    DependenciesJob(std::initializer_list<Job*> dependencies) : dependencies_(dependencies){}
+    DependenciesJob(std::initializer_list<Job*> dependencies);
     [[nodiscard]] bool ShouldStart() const override;
-    bool AddDependency(Job* dependency);
+    /**
+     * \brief AddDependency must not be called while the job is in flight, as it can move the links
+     * @return false if dependency is null, or if it would close a cycle (only checked with Validate)
+     */
+    bool AddDependency(Job* dependency, DependencyCheck check = DependencyCheck::Validate);
     void Execute() override;
 protected:
-    bool CheckDependency(const Job *ptr) const override;
-    std::vector<Job*> dependencies_{};
+    std::span<DependencyLink> GetDependencyLinks() override { return dependencies_; }
+    std::vector<DependencyLink> dependencies_{};
 };
 
 template<size_t N>
 class FixedDependenciesJob : Job
 {
 public:
-    bool AddDependency(Job* dependency);
+    bool AddDependency(Job* dependency, DependencyCheck check = DependencyCheck::Validate);
     void Execute() override;
     bool ShouldStart() const override;
 protected:
-    bool CheckDependency(const Job *ptr) const override;
-    std::array<Job*, N> dependencies_{};
+    std::span<DependencyLink> GetDependencyLinks() override { return dependencies_; }
+    std::array<DependencyLink, N> dependencies_{};
 };
 
 
 template<size_t N>
-bool FixedDependenciesJob<N>::AddDependency(Job* dependency)
+bool FixedDependenciesJob<N>::AddDependency(Job* dependency, DependencyCheck check)
 {
-    if (dependency == nullptr || dependency->CheckDependency(this))
+    if (dependency == nullptr || (check == DependencyCheck::Validate && dependency->CheckDependency(this)))
     {
         return false;
     }
-    auto it = std::find(dependencies_.begin(), dependencies_.end(), nullptr);
+    auto it = std::find_if(dependencies_.begin(), dependencies_.end(), [](const auto& link)
+    {
+        return link.dependency == nullptr;
+    });
     if (it != dependencies_.end())
     {
-        *it = dependency;
+        *it = {dependency, this};
         return true;
     }
     return false;
@@ -107,12 +328,12 @@ bool FixedDependenciesJob<N>::AddDependency(Job* dependency)
 template<size_t N>
 void FixedDependenciesJob<N>::Execute()
 {
-    for(auto& dependency : dependencies_)
+    for(auto& link : dependencies_)
     {
-        if(dependency != nullptr)
+        if(link.dependency != nullptr)
         {
-            dependency->Join();
-            if (dependency->HasFailed())
+            link.dependency->Join();
+            if (link.dependency->HasFailed())
             {
                 SkipAsFailed();
                 return;
@@ -126,9 +347,9 @@ template<size_t N>
 bool FixedDependenciesJob<N>::ShouldStart() const
 {
     bool shouldStart = true;
-    for (auto& dependency : dependencies_)
+    for (auto& link : dependencies_)
     {
-        if (dependency != nullptr && !dependency->IsDone())
+        if (link.dependency != nullptr && !link.dependency->IsDone())
         {
             shouldStart = false;
             break;
@@ -137,17 +358,77 @@ bool FixedDependenciesJob<N>::ShouldStart() const
     return shouldStart;
 }
 
-template<size_t N>
-bool FixedDependenciesJob<N>::CheckDependency(const Job* ptr) const
+/**
+ * \brief QueueMode selects how the workers of a queue share its jobs.
+ * Fifo: every worker pops from the single shared queue.
+ * WorkStealing: every worker owns a Chase-Lev deque. Jobs added from one of the queue's own workers
+ * are pushed on that worker's deque, other jobs go to the shared queue, and idle workers steal from
+ * random siblings. The priority lanes only order the shared queue: High priority jobs always go
+ * there, and workers take them before their own deque.
+ * Both modes dequeue the shared queue in small batches, up to a fair share of its jobs per worker. The
+ * rest of a batch waits on the worker's deque, where idle siblings can steal it.
+ */
+enum class QueueMode
 {
-    return std::any_of(dependencies_.begin(), dependencies_.end(), [ptr](const auto* dep){
-        if (dep == nullptr)
-            return false;
-        return dep->CheckDependency(ptr);
-    });
-}
+    Fifo,
+    WorkStealing
+};
 
-static constexpr auto MAIN_QUEUE_INDEX = -1;
+/**
+ * \brief IdlePolicy is what a thread does when its queue runs dry: it first polls spinCount times with a
+ * cpu pause in between, then yieldCount times yielding its time slice, and finally parks until a job is
+ * added. Spinning trades idle power for submit-to-start latency, parked threads cost nothing.
+ */
+struct IdlePolicy
+{
+    std::uint32_t spinCount = 256;
+    std::uint32_t yieldCount = 16;
+};
+
+/**
+ * \brief LatencyHistogram counts durations in power of two buckets: bucket 0 is 0ns, bucket i > 0 is
+ * [2^(i-1), 2^i) ns, and the last bucket also takes everything above (about 1s and more).
+ */
+struct LatencyHistogram
+{
+    static constexpr std::size_t BUCKET_COUNT = 32;
+    std::array<std::uint64_t, BUCKET_COUNT> buckets{};
+
+    static constexpr std::size_t GetBucket(std::uint64_t nanoseconds)
+    {
+        return std::min<std::size_t>(static_cast<std::size_t>(std::bit_width(nanoseconds)), BUCKET_COUNT - 1);
+    }
+    [[nodiscard]] std::uint64_t GetCount() const;
+    LatencyHistogram& operator+=(const LatencyHistogram& other);
+};
+
+/**
+ * \brief ThreadStats are the counters of one thread executing jobs, since Begin. Busy time is spent
+ * executing jobs, idle time waiting for them once the queue ran dry. The start latency goes from the
+ * moment a job is ready and enqueued to the moment it starts.
+ */
+struct ThreadStats
+{
+    int queueIndex = MAIN_QUEUE_INDEX;
+    std::size_t workerIndex = 0;
+    std::uint64_t executedJobs = 0;
+    // Jobs put back in the queue because their ShouldStart() returned false
+    std::uint64_t requeuedJobs = 0;
+    std::chrono::nanoseconds busyTime{};
+    std::chrono::nanoseconds idleTime{};
+    LatencyHistogram startLatency{};
+};
+
+/**
+ * \brief JobSystemStats is a snapshot of the counters of every thread. queues sums the workers of each
+ * queue (indexed by queue index) and mainThread is the thread calling ExecuteMainThread.
+ */
+struct JobSystemStats
+{
+    ThreadStats mainThread{};
+    std::vector<ThreadStats> queues;
+    std::vector<ThreadStats> workers;
+};
 
 /// Dynamically adds a contained job to a target queue once its own dependency
 /// has finished.  Useful when a job must run on a specific queue (e.g. the main
@@ -163,37 +444,521 @@ class ScheduleJob : public Job
 {
 public:
     ScheduleJob(Job* containedJob, int queueIndex, Job* dependency = nullptr)
-        : containedJob_(containedJob), queueIndex_(queueIndex), dependency_(dependency) {}
+        : containedJob_(containedJob), queueIndex_(queueIndex), dependency_{dependency, this} {}
 
     void Execute() override;
     [[nodiscard]] bool ShouldStart() const override;
-    [[nodiscard]] bool CheckDependency(const Job* ptr) const override;
 
 protected:
     void ExecuteImpl() override {}
+    std::span<DependencyLink> GetDependencyLinks() override { return {&dependency_, 1}; }
 
 private:
     Job* containedJob_;
     int queueIndex_;
-    Job* dependency_;
+    DependencyLink dependency_;
 };
 
-namespace JobSystem
+class JobPool;
+class AffinityPolicy;
+
+/**
+ * \brief FunctionJob is the job slot behind JobSystem::Submit. The callable is stored in a small
+ * inline buffer (only bigger ones are heap-allocated), and the slot comes from the submitting thread
+ * pool. It is given back once it has run and no JobHandle refers to it anymore.
+ */
+class FunctionJob final : public Job
 {
+public:
+    static constexpr std::size_t bufferSize = 64;
+
+    FunctionJob() = default;
+    FunctionJob(const FunctionJob&) = delete;
+    FunctionJob& operator=(const FunctionJob&) = delete;
+
+    template<typename Func>
+    void SetFunction(Func&& func);
+    void Execute() override;
+
+    void AddReference() { references_.fetch_add(1, std::memory_order_relaxed); }
+    void RemoveReference();
+protected:
+    void ExecuteImpl() override { invoke_(storage_); }
+private:
+    friend class JobPool;
+    using InvokeFunction = void(*)(void* storage);
+    using DestroyFunction = void(*)(void* storage);
+
+    alignas(std::max_align_t) std::byte storage_[bufferSize]{};
+    InvokeFunction invoke_ = nullptr;
+    DestroyFunction destroy_ = nullptr;
+    // One reference for the pending execution, one per JobHandle
+    std::atomic<int> references_{ 0 };
+    JobPool* pool_ = nullptr;
+    FunctionJob* nextFree_ = nullptr;
+};
+
+template<typename Func>
+void FunctionJob::SetFunction(Func&& func)
+{
+    using FuncType = std::decay_t<Func>;
+    if constexpr (sizeof(FuncType) <= bufferSize && alignof(FuncType) <= alignof(std::max_align_t))
+    {
+        new (storage_) FuncType(std::forward<Func>(func));
+        invoke_ = [](void* storage) { (*std::launder(static_cast<FuncType*>(storage)))(); };
+        destroy_ = [](void* storage) { std::launder(static_cast<FuncType*>(storage))->~FuncType(); };
+    }
+    else
+    {
+        new (storage_) FuncType*(new FuncType(std::forward<Func>(func)));
+        invoke_ = [](void* storage) { (**std::launder(static_cast<FuncType**>(storage)))(); };
+        destroy_ = [](void* storage) { delete *std::launder(static_cast<FuncType**>(storage)); };
+    }
+}
+
+/**
+ * \brief JobHandle keeps a submitted FunctionJob alive so that it can be joined or used as a
+ * dependency, the slot goes back to its pool once the last handle is gone
+ */
+class JobHandle
+{
+public:
+    JobHandle() = default;
+    explicit JobHandle(FunctionJob* job) : job_(job) { if (job_ != nullptr) job_->AddReference(); }
+    JobHandle(const JobHandle& other) : JobHandle(other.job_) {}
+    JobHandle(JobHandle&& other) noexcept : job_(std::exchange(other.job_, nullptr)) {}
+    JobHandle& operator=(JobHandle other) noexcept
+    {
+        std::swap(job_, other.job_);
+        return *this;
+    }
+    ~JobHandle() { if (job_ != nullptr) job_->RemoveReference(); }
+
+    [[nodiscard]] Job* GetJob() const { return job_; }
+    [[nodiscard]] bool IsDone() const { return job_->IsDone(); }
+    [[nodiscard]] bool HasFailed() const { return job_->HasFailed(); }
+    void Join() const { job_->Join(); }
+private:
+    FunctionJob* job_ = nullptr;
+};
+
+/**
+ * \brief ValueJob is a job producing a T, stored inline in the job instead of the shared state of a
+ * std::promise. An exception thrown by ComputeValue fails the job like any other, and Get rethrows it.
+ */
+template<typename T>
+class ValueJob : public Job
+{
+public:
+    static_assert(!std::is_reference_v<T> && !std::is_void_v<T>, "ValueJob needs an object type");
+
+    /**
+     * \brief Get joins the job (helping the caller's queue if possible) and returns its value
+     * @throw the exception of ComputeValue, or std::runtime_error if the job was cancelled or a dependency failed
+     */
+    T& Get()
+    {
+        Join();
+        ThrowIfFailed();
+        return *value_;
+    }
+    const T& Get() const
+    {
+        Join();
+        ThrowIfFailed();
+        return *value_;
+    }
     /**
-     * @brief SetupNewQueue is a member function that adds a new queue in the JobSystem and
+     * \brief HasValue is true once the job is done without failing
+     */
+    [[nodiscard]] bool HasValue() const { return IsDone() && !HasFailed(); }
+protected:
+    virtual T ComputeValue() = 0;
+    void ExecuteImpl() final
+    {
+        value_.reset();
+        exception_ = nullptr;
+        try
+        {
+            value_.emplace(ComputeValue());
+        }
+        catch (...)
+        {
+            exception_ = std::current_exception();
+            throw;
+        }
+    }
+private:
+    void ThrowIfFailed() const
+    {
+        if (exception_ != nullptr)
+        {
+            std::rethrow_exception(exception_);
+        }
+        if (HasFailed() || !value_.has_value())
+        {
+            throw std::runtime_error("ValueJob has no value, it was cancelled or one of its dependencies failed");
+        }
+    }
+
+    std::optional<T> value_;
+    std::exception_ptr exception_;
+};
+
+/**
+ * \brief FunctionValueJob is a ValueJob returning the result of a callable
+ */
+template<typename Func>
+class FunctionValueJob final : public ValueJob<std::invoke_result_t<Func&>>
+{
+public:
+    explicit FunctionValueJob(Func func) : func_(std::move(func)) {}
+protected:
+    std::invoke_result_t<Func&> ComputeValue() override { return func_(); }
+private:
+    Func func_;
+};
+
+class JobSchedulerState;
+
+/**
+ * \brief MainThreadBudget bounds one ExecuteMainThread call, so that the main loop keeps its frame rate:
+ * the jobs left over run on the next call
+ */
+struct MainThreadBudget
+{
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    std::size_t maxJobCount = std::numeric_limits<std::size_t>::max();
+
+    static MainThreadBudget FromDuration(std::chrono::steady_clock::duration duration,
+        std::size_t maxJobCount = std::numeric_limits<std::size_t>::max())
+    {
+        return {std::chrono::steady_clock::now() + duration, maxJobCount};
+    }
+};
+
+/**
+ * \brief JobScheduler owns a set of queues with their worker threads and a main thread queue. Several
+ * schedulers can run side by side, each with its own pools. The JobSystem free functions forward to a
+ * default instance. A job remembers the scheduler it was added to: its dependents are dispatched there.
+ */
+class JobScheduler
+{
+public:
+    JobScheduler();
+    /**
+     * \brief The destructor ends the scheduler if it is still running
+     */
+    ~JobScheduler();
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    /**
+     * @brief SetupNewQueue is a member function that adds a new queue in the JobScheduler and
      * adds a certain number of threads attached to it. It must be called before the Begin member function
      */
-    int SetupNewQueue(int threadCount = 1);
+    int SetupNewQueue(int threadCount = 1, QueueMode mode = QueueMode::Fifo);
+    /**
+     * @brief SetupNewQueue overload pinning each worker thread to the cpus given by the affinity
+     * policy (see AffinityPolicy). Pinning is best effort and a no-op on platforms without thread affinity.
+     */
+    int SetupNewQueue(int threadCount, const AffinityPolicy& affinity, QueueMode mode = QueueMode::Fifo);
+    /**
+     * @brief SetPriorityAging makes one dequeue out of interval on the queue start from its lowest
+     * priority lane, so that a steady stream of higher priority jobs cannot starve it. 0 (the default)
+     * disables it. It must be called before the Begin member function.
+     */
+    void SetPriorityAging(int queueIndex, std::uint32_t interval);
+    /**
+     * @brief SetIdlePolicy sets how the threads of the queue wait for jobs, see IdlePolicy.
+     * It must be called before the Begin member function.
+     */
+    void SetIdlePolicy(int queueIndex, const IdlePolicy& policy);
+    /**
+     * @brief Begin is a member function that starts the queues and threads of the JobScheduler.
+     */
+    void Begin();
+    /**
+     * @brief Pause waits for the workers to finish the jobs already in their queues, then parks them
+     * until Resume. Jobs added meanwhile wait in the queues. It keeps the threads alive, so a
+     * Pause/Resume pair is much cheaper than End and Begin.
+     * @throw std::logic_error if called from a worker of this scheduler, it would wait for itself
+     */
+    void Pause();
+    void Resume();
+    /**
+     * @brief End finishes the queued jobs, joins the worker threads and removes the queues. The jobs of
+     * the main thread queue are kept for the next ExecuteMainThread, the main thread jobs still waiting
+     * on their dependencies are not counted anymore.
+     */
+    void End();
+    [[nodiscard]] bool IsRunning() const;
+    [[nodiscard]] bool IsPaused() const;
+
+    /**
+     * @brief AddJob resets the job and registers it on its dependencies. It is enqueued exactly once,
+     * by whichever thread finishes its last dependency (or right away when it has none), so a waiting
+     * job costs nothing. A reused dependency must be added again before its dependent jobs, otherwise
+     * its previous run still counts as done.
+     */
+    void AddJob(Job* newJob, int queueIndex = MAIN_QUEUE_INDEX, JobPriority priority = JobPriority::Normal);
+    /**
+     * @brief AddJobs is AddJob for a batch of jobs, the ones ready right away are enqueued in bulk
+     */
+    void AddJobs(std::span<Job* const> newJobs, int queueIndex = MAIN_QUEUE_INDEX,
+        JobPriority priority = JobPriority::Normal);
+    /**
+     * @brief AddJobs overload counting the jobs in counter, so that they can be waited on as a group
+     */
+    void AddJobs(std::span<Job* const> newJobs, JobCounter& counter, int queueIndex = MAIN_QUEUE_INDEX,
+        JobPriority priority = JobPriority::Normal);
+    /**
+     * @brief Submit adds func as a pooled FunctionJob, without any allocation when it fits in its buffer.
+     * The returned handle can be dropped: the slot is given back once the job has run.
+     */
+    template<typename Func>
+    JobHandle Submit(Func&& func, int queueIndex = MAIN_QUEUE_INDEX, JobPriority priority = JobPriority::Normal);
+    /**
+     * @brief ExecuteMainThread executes the main thread queue until every job added to it is done,
+     * waiting for the ones still on their dependencies
+     */
+    void ExecuteMainThread();
+    /**
+     * @brief ExecuteMainThread overload that never waits: it returns once the budget is spent, or once
+     * the queue holds no ready job anymore. Jobs found not ready are put back for the next call.
+     * @return the number of jobs executed
+     */
+    std::size_t ExecuteMainThread(const MainThreadBudget& budget);
+
+    using WaitPredicate = bool(*)(const void* userData);
+    /**
+     * @brief HelpWhileWaiting executes ready jobs of the calling thread's own queue (its worker queue,
+     * or the main thread queue for the thread that called Begin) until isDone(userData) returns true.
+     * It returns early once that queue stayed empty for the spin and yield phases of its IdlePolicy, or
+     * when the calling thread is already nested maxHelpDepth waits deep, so the caller must still block
+     * afterwards. The main thread does not return while main queue jobs are pending, it parks instead
+     * until a job is added to its queue or NotifyWaiters is called: whatever makes isDone true must
+     * call it. Any job can run inside the wait: the caller must not hold locks those jobs need.
+     */
+    void HelpWhileWaiting(WaitPredicate isDone, const void* userData);
+    /**
+     * @brief NotifyWaiters wakes the main thread up when it is parked in HelpWhileWaiting. Jobs waited
+     * on with Join, counters and graphs already call it when done.
+     */
+    void NotifyWaiters();
+    static constexpr int maxHelpDepth = 16;
+
+    using RangeFunction = void(*)(void* userData, std::size_t begin, std::size_t end);
+    /**
+     * @brief ParallelForRange calls func on sub-ranges covering [begin, end) on the workers of queueIndex,
+     * with lazy binary splitting: the range is processed grainSize items at a time, and the upper half
+     * of what remains is split off as a new job only when the queue runs out of work. The caller runs
+     * the first part itself and helps executing the queue until every sub-range is done. It does not
+     * allocate, the split jobs live on the caller stack.
+     * @param grainSize 0 picks one from the range size and the worker count
+     */
+    void ParallelForRange(std::size_t begin, std::size_t end, RangeFunction func, void* userData,
+        int queueIndex, std::size_t grainSize = 0);
+    template<typename Func>
+    void ParallelForRange(std::size_t begin, std::size_t end, Func&& func, int queueIndex, std::size_t grainSize = 0);
     /**
-     * @brief Begin is a member function that starts the queues and threads of the JobSystem.
+     * @brief ParallelFor calls func(i) for every i in [begin, end), see ParallelForRange
      */
+    template<typename Func>
+    void ParallelFor(std::size_t begin, std::size_t end, Func&& func, int queueIndex, std::size_t grainSize = 0);
+    /**
+     * @brief ParallelFor2D calls func(x, y) for every x in [beginX, endX) and y in [beginY, endY),
+     * the rows being split like a single flattened range
+     */
+    template<typename Func>
+    void ParallelFor2D(std::size_t beginX, std::size_t endX, std::size_t beginY, std::size_t endY,
+        Func&& func, int queueIndex, std::size_t grainSize = 0);
+
+    /**
+     * @brief GetStats takes a snapshot of the scheduler counters, cheap enough to be scraped
+     * periodically. The counters are relaxed atomics, so the snapshot is not one consistent instant.
+     * Worker counters are only available between Begin and End.
+     */
+    [[nodiscard]] JobSystemStats GetStats() const;
+
+    /**
+     * @brief AddJobAfter adds the job to queueIndex once delay has elapsed, never earlier, with the
+     * 1 ms precision of the timer wheel. The timers are kept by a timer thread started on first use,
+     * which sleeps until the next deadline and moves the due jobs to their queues in batches. End
+     * drops the timers still pending.
+     * @return the timer to cancel, INVALID_TIMER_ID when the delay is not positive and the job was
+     * added right away
+     */
+    TimerId AddJobAfter(Job* job, std::chrono::steady_clock::duration delay, int queueIndex = MAIN_QUEUE_INDEX,
+        JobPriority priority = JobPriority::Normal);
+    /**
+     * @brief AddPeriodicJob adds the job every period, first after one period, until the timer is cancelled.
+     * The due times do not drift. A run is skipped when the previous one is not done yet.
+     */
+    TimerId AddPeriodicJob(Job* job, std::chrono::steady_clock::duration period, int queueIndex = MAIN_QUEUE_INDEX,
+        JobPriority priority = JobPriority::Normal);
+    /**
+     * @brief CancelTimer stops a pending timer. A timer that just expired may still add its job once.
+     * @return false if the timer already expired or was cancelled
+     */
+    bool CancelTimer(TimerId timerId);
+    /**
+     * @brief GetExpectedDuration is the moving average of the execution time of the jobs of key,
+     * zero when none ran yet
+     */
+    [[nodiscard]] std::chrono::nanoseconds GetExpectedDuration(DurationKey key) const;
+    /**
+     * @brief ExportDurationHistory copies the recorded execution times, to be saved and given back to
+     * ImportDurationHistory on the next run, so that the first frames are already in the right order
+     */
+    [[nodiscard]] std::vector<DurationRecord> ExportDurationHistory() const;
+    void ImportDurationHistory(std::span<const DurationRecord> records);
+private:
+    friend class Job;
+    friend class JobGraph;
+    /**
+     * @brief ReserveMainThreadJobs counts main queue jobs as pending before they are added, so that
+     * ExecuteMainThread and a main thread helping while it waits keep waiting for them. Each of them is
+     * then added with AddReservedMainThreadJob.
+     */
+    void ReserveMainThreadJobs(int count);
+    void AddReservedMainThreadJob(Job* newJob);
+    std::unique_ptr<JobSchedulerState> state_;
+};
+
+/**
+ * \brief The JobSystem free functions forward to the default JobScheduler, see its member functions
+ */
+namespace JobSystem
+{
+    /**
+     * @brief GetScheduler returns the default scheduler, created on first use
+     */
+    JobScheduler& GetScheduler();
+
+    int SetupNewQueue(int threadCount = 1, QueueMode mode = QueueMode::Fifo);
+    int SetupNewQueue(int threadCount, const AffinityPolicy& affinity, QueueMode mode = QueueMode::Fifo);
     void Begin();
-    void AddJob(Job* newJob, int queueIndex = MAIN_QUEUE_INDEX);
+    void Pause();
+    void Resume();
+    void AddJob(Job* newJob, int queueIndex = MAIN_QUEUE_INDEX, JobPriority priority = JobPriority::Normal);
+    void AddJobs(std::span<Job* const> newJobs, int queueIndex = MAIN_QUEUE_INDEX,
+        JobPriority priority = JobPriority::Normal);
+    void AddJobs(std::span<Job* const> newJobs, JobCounter& counter, int queueIndex = MAIN_QUEUE_INDEX,
+        JobPriority priority = JobPriority::Normal);
+    void SetPriorityAging(int queueIndex, std::uint32_t interval);
+    void SetIdlePolicy(int queueIndex, const IdlePolicy& policy);
+    JobSystemStats GetStats();
+    TimerId AddJobAfter(Job* job, std::chrono::steady_clock::duration delay, int queueIndex = MAIN_QUEUE_INDEX,
+        JobPriority priority = JobPriority::Normal);
+    TimerId AddPeriodicJob(Job* job, std::chrono::steady_clock::duration period, int queueIndex = MAIN_QUEUE_INDEX,
+        JobPriority priority = JobPriority::Normal);
+    bool CancelTimer(TimerId timerId);
+    std::chrono::nanoseconds GetExpectedDuration(DurationKey key);
+    std::vector<DurationRecord> ExportDurationHistory();
+    void ImportDurationHistory(std::span<const DurationRecord> records);
+    /**
+     * @brief AcquireFunctionJob takes a free slot from the calling thread job pool (lock-free)
+     */
+    FunctionJob* AcquireFunctionJob();
+    /**
+     * @brief GetFunctionJobSlotCount is the number of slots allocated by the calling thread job pool,
+     * free or in use. It only grows when every slot is taken.
+     */
+    std::size_t GetFunctionJobSlotCount();
+    template<typename Func>
+    JobHandle Submit(Func&& func, int queueIndex = MAIN_QUEUE_INDEX, JobPriority priority = JobPriority::Normal)
+    {
+        return GetScheduler().Submit(std::forward<Func>(func), queueIndex, priority);
+    }
     void End();
     void ExecuteMainThread();
+    std::size_t ExecuteMainThread(const MainThreadBudget& budget);
+
+    using WaitPredicate = JobScheduler::WaitPredicate;
+    void HelpWhileWaiting(WaitPredicate isDone, const void* userData);
+    void NotifyWaiters();
 
+    using RangeFunction = JobScheduler::RangeFunction;
+    void ParallelForRange(std::size_t begin, std::size_t end, RangeFunction func, void* userData,
+        int queueIndex, std::size_t grainSize = 0);
+
+    template<typename Func>
+    void ParallelForRange(std::size_t begin, std::size_t end, Func&& func, int queueIndex, std::size_t grainSize = 0)
+    {
+        GetScheduler().ParallelForRange(begin, end, std::forward<Func>(func), queueIndex, grainSize);
+    }
+
+    template<typename Func>
+    void ParallelFor(std::size_t begin, std::size_t end, Func&& func, int queueIndex, std::size_t grainSize = 0)
+    {
+        GetScheduler().ParallelFor(begin, end, std::forward<Func>(func), queueIndex, grainSize);
+    }
+
+    template<typename Func>
+    void ParallelFor2D(std::size_t beginX, std::size_t endX, std::size_t beginY, std::size_t endY,
+        Func&& func, int queueIndex, std::size_t grainSize = 0)
+    {
+        GetScheduler().ParallelFor2D(beginX, endX, beginY, endY, std::forward<Func>(func), queueIndex, grainSize);
+    }
 };
 
+template<typename Func>
+JobHandle JobScheduler::Submit(Func&& func, int queueIndex, JobPriority priority)
+{
+    auto* job = JobSystem::AcquireFunctionJob();
+    job->SetFunction(std::forward<Func>(func));
+    JobHandle handle{job};
+    AddJob(job, queueIndex, priority);
+    return handle;
+}
+
+template<typename Func>
+void JobScheduler::ParallelForRange(std::size_t begin, std::size_t end, Func&& func, int queueIndex, std::size_t grainSize)
+{
+    using FuncType = std::remove_reference_t<Func>;
+    ParallelForRange(begin, end, [](void* userData, std::size_t rangeBegin, std::size_t rangeEnd)
+    {
+        (*static_cast<FuncType*>(userData))(rangeBegin, rangeEnd);
+    }, const_cast<void*>(static_cast<const void*>(std::addressof(func))), queueIndex, grainSize);
+}
+
+template<typename Func>
+void JobScheduler::ParallelFor(std::size_t begin, std::size_t end, Func&& func, int queueIndex, std::size_t grainSize)
+{
+    ParallelForRange(begin, end, [&func](std::size_t rangeBegin, std::size_t rangeEnd)
+    {
+        for (auto i = rangeBegin; i < rangeEnd; i++)
+        {
+            func(i);
+        }
+    }, queueIndex, grainSize);
+}
+
+template<typename Func>
+void JobScheduler::ParallelFor2D(std::size_t beginX, std::size_t endX, std::size_t beginY, std::size_t endY,
+    Func&& func, int queueIndex, std::size_t grainSize)
+{
+    if (endX <= beginX || endY <= beginY)
+    {
+        return;
+    }
+    const auto width = endX - beginX;
+    ParallelForRange(0, width * (endY - beginY), [&func, width, beginX, beginY](std::size_t rangeBegin, std::size_t rangeEnd)
+    {
+        auto x = beginX + rangeBegin % width;
+        auto y = beginY + rangeBegin / width;
+        for (auto i = rangeBegin; i < rangeEnd; i++)
+        {
+            func(x, y);
+            if (++x == beginX + width)
+            {
+                x = beginX;
+                y++;
+            }
+        }
+    }, queueIndex, grainSize);
+}
+
 }
 #endif //NEKOLIB_JOB_SYSTEM_H
@@ -0,0 +1,291 @@
+#ifndef NEKOLIB_PARALLEL_ALGORITHM_H
+#define NEKOLIB_PARALLEL_ALGORITHM_H
+
+#include "thread/job_system.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace neko
+{
+
+/**
+ * \brief Parallel algorithms over contiguous ranges (std::vector, SmallVector, FixedVector, arrays...),
+ * executed on a queue of the default JobScheduler with JobSystem::ParallelForRange. The calling thread
+ * works on the range too and helps the queue until the algorithm is done, so calling them from a job
+ * of the same queue is fine. With MAIN_QUEUE_INDEX, or a range shorter than one block, they run
+ * sequentially on the calling thread.
+ *
+ * The range is cut in blocks of grainSize elements, 0 picking a block size from the range size. The
+ * block results are combined in order, so Reduce and InclusiveScan only need an associative operation,
+ * where std::reduce also needs it to be commutative.
+ */
+namespace Parallel
+{
+    static constexpr std::size_t minBlockSize = 512;
+    static constexpr std::size_t maxBlockCount = 256;
+
+    /**
+     * @brief GetBlockSize is the block size of a range of size elements, see grainSize
+     */
+    constexpr std::size_t GetBlockSize(std::size_t size, std::size_t grainSize)
+    {
+        if (grainSize != 0)
+        {
+            return grainSize;
+        }
+        return std::max(minBlockSize, (size + maxBlockCount - 1) / maxBlockCount);
+    }
+
+    /**
+     * @brief ForEachBlock calls func(blockIndex, begin, end) for every block of [0, size), in parallel
+     */
+    template<typename Func>
+    void ForEachBlock(std::size_t size, std::size_t blockSize, Func&& func, int queueIndex)
+    {
+        const auto blockCount = (size + blockSize - 1) / blockSize;
+        JobSystem::ParallelForRange(0, blockCount, [&func, size, blockSize](std::size_t blockBegin, std::size_t blockEnd)
+        {
+            for (auto block = blockBegin; block < blockEnd; block++)
+            {
+                func(block, block * blockSize, std::min(size, (block + 1) * blockSize));
+            }
+        }, queueIndex, 1);
+    }
+
+    /**
+     * @brief ForEach calls func(element) on every element of range
+     */
+    template<std::ranges::contiguous_range Range, typename Func>
+    void ForEach(Range&& range, Func&& func, int queueIndex, std::size_t grainSize = 0)
+    {
+        auto* data = std::ranges::data(range);
+        const auto size = static_cast<std::size_t>(std::ranges::size(range));
+        JobSystem::ParallelForRange(0, size, [data, &func](std::size_t begin, std::size_t end)
+        {
+            for (auto i = begin; i < end; i++)
+            {
+                func(data[i]);
+            }
+        }, queueIndex, GetBlockSize(size, grainSize));
+    }
+
+    /**
+     * @brief TransformReduce returns init combined with transform(element) of every element, with reduce
+     */
+    template<std::ranges::contiguous_range Range, typename T, typename ReduceOp, typename TransformOp>
+    T TransformReduce(Range&& range, T init, ReduceOp reduce, TransformOp transform, int queueIndex,
+        std::size_t grainSize = 0)
+    {
+        auto* data = std::ranges::data(range);
+        const auto size = static_cast<std::size_t>(std::ranges::size(range));
+        const auto blockSize = GetBlockSize(size, grainSize);
+        if (size <= blockSize || queueIndex == MAIN_QUEUE_INDEX)
+        {
+            for (std::size_t i = 0; i < size; i++)
+            {
+                init = reduce(std::move(init), transform(data[i]));
+            }
+            return init;
+        }
+        // Blocks are never empty, so each partial starts from its first element instead of an identity
+        std::vector<std::optional<T>> partials((size + blockSize - 1) / blockSize);
+        ForEachBlock(size, blockSize, [data, &partials, &reduce, &transform](std::size_t block, std::size_t begin, std::size_t end)
+        {
+            T partial = transform(data[begin]);
+            for (auto i = begin + 1; i < end; i++)
+            {
+                partial = reduce(std::move(partial), transform(data[i]));
+            }
+            partials[block].emplace(std::move(partial));
+        }, queueIndex);
+        for (auto& partial : partials)
+        {
+            init = reduce(std::move(init), std::move(*partial));
+        }
+        return init;
+    }
+
+    /**
+     * @brief Reduce returns init combined with every element of range, with reduce (std::plus by default)
+     */
+    template<std::ranges::contiguous_range Range, typename T, typename ReduceOp = std::plus<>>
+    T Reduce(Range&& range, T init, int queueIndex, ReduceOp reduce = {}, std::size_t grainSize = 0)
+    {
+        return TransformReduce(std::forward<Range>(range), std::move(init), reduce,
+            [](const auto& value) -> decltype(auto) { return value; }, queueIndex, grainSize);
+    }
+
+    /**
+     * @brief InclusiveScan writes to output the running reduction of input, output[i] combining input[0]
+     * to input[i]. output must be at least as long as input, and can be input itself.
+     */
+    template<std::ranges::contiguous_range InputRange, std::ranges::contiguous_range OutputRange,
+        typename ReduceOp = std::plus<>>
+    void InclusiveScan(InputRange&& input, OutputRange&& output, int queueIndex, ReduceOp reduce = {},
+        std::size_t grainSize = 0)
+    {
+        const auto* in = std::ranges::data(input);
+        auto* out = std::ranges::data(output);
+        const auto size = static_cast<std::size_t>(std::ranges::size(input));
+        const auto blockSize = GetBlockSize(size, grainSize);
+        if (size <= blockSize || queueIndex == MAIN_QUEUE_INDEX)
+        {
+            std::inclusive_scan(in, in + size, out, reduce);
+            return;
+        }
+        using T = std::remove_cvref_t<decltype(*out)>;
+        // First the sum of each block, then the scan of each block from the sum of the previous ones
+        const auto blockCount = (size + blockSize - 1) / blockSize;
+        // The last block sum is never needed, so only the full blocks are summed
+        std::vector<std::optional<T>> blockSums(blockCount - 1);
+        ForEachBlock((blockCount - 1) * blockSize, blockSize, [in, &blockSums, &reduce](std::size_t block, std::size_t begin, std::size_t end)
+        {
+            T sum = in[begin];
+            for (auto i = begin + 1; i < end; i++)
+            {
+                sum = reduce(std::move(sum), in[i]);
+            }
+            blockSums[block].emplace(std::move(sum));
+        }, queueIndex);
+        for (std::size_t block = 1; block < blockSums.size(); block++)
+        {
+            blockSums[block] = reduce(*blockSums[block - 1], std::move(*blockSums[block]));
+        }
+        ForEachBlock(size, blockSize, [in, out, &blockSums, &reduce](std::size_t block, std::size_t begin, std::size_t end)
+        {
+            T sum = block == 0 ? T(in[begin]) : reduce(*blockSums[block - 1], in[begin]);
+            out[begin] = sum;
+            for (auto i = begin + 1; i < end; i++)
+            {
+                sum = reduce(std::move(sum), in[i]);
+                out[i] = sum;
+            }
+        }, queueIndex);
+    }
+
+    /**
+     * @brief Sort sorts range with comp, like std::sort it is not stable. Blocks are sorted in parallel,
+     * then merged pairwise, each merge being split in parallel pieces too. The elements must be default
+     * constructible, for the merge buffer.
+     */
+    template<std::ranges::contiguous_range Range, typename Compare = std::less<>>
+    void Sort(Range&& range, int queueIndex, Compare comp = {}, std::size_t grainSize = 0)
+    {
+        auto* data = std::ranges::data(range);
+        const auto size = static_cast<std::size_t>(std::ranges::size(range));
+        const auto blockSize = GetBlockSize(size, grainSize);
+        if (size <= blockSize || queueIndex == MAIN_QUEUE_INDEX)
+        {
+            std::sort(data, data + size, comp);
+            return;
+        }
+        using T = std::remove_cvref_t<decltype(*data)>;
+        ForEachBlock(size, blockSize, [data, &comp](std::size_t, std::size_t begin, std::size_t end)
+        {
+            std::sort(data + begin, data + end, comp);
+        }, queueIndex);
+
+        std::vector<T> buffer(size);
+        auto* source = data;
+        auto* destination = buffer.data();
+        for (auto width = blockSize; width < size; width *= 2)
+        {
+            // Every pair of runs is merged in pieces of at most blockSize elements of its left run, the
+            // matching part of the right run found by binary search
+            const auto piecesPerPair = (width + blockSize - 1) / blockSize;
+            const auto pairCount = (size + 2 * width - 1) / (2 * width);
+            JobSystem::ParallelForRange(0, pairCount * piecesPerPair,
+                [source, destination, &comp, size, width, blockSize, piecesPerPair](std::size_t pieceBegin, std::size_t pieceEnd)
+            {
+                for (auto piece = pieceBegin; piece < pieceEnd; piece++)
+                {
+                    const auto leftBegin = piece / piecesPerPair * 2 * width;
+                    const auto leftEnd = std::min(size, leftBegin + width);
+                    const auto rightEnd = std::min(size, leftEnd + width);
+                    const auto pieceIndex = piece % piecesPerPair;
+                    const auto first = leftBegin + pieceIndex * blockSize;
+                    if (first >= leftEnd)
+                    {
+                        continue;
+                    }
+                    const auto last = std::min(leftEnd, first + blockSize);
+                    // Right elements equal to a left one go after it, as with std::merge
+                    auto* right = source + leftEnd;
+                    const auto rightFirst = pieceIndex == 0 ? right :
+                        std::lower_bound(right, source + rightEnd, source[first], comp);
+                    const auto rightLast = last == leftEnd ? source + rightEnd :
+                        std::lower_bound(right, source + rightEnd, source[last], comp);
+                    const auto outputIndex = first + static_cast<std::size_t>(rightFirst - right);
+                    std::merge(std::make_move_iterator(source + first), std::make_move_iterator(source + last),
+                        std::make_move_iterator(rightFirst), std::make_move_iterator(rightLast),
+                        destination + outputIndex, comp);
+                }
+            }, queueIndex, 1);
+            std::swap(source, destination);
+        }
+        if (source != data)
+        {
+            ForEachBlock(size, blockSize, [source, data](std::size_t, std::size_t begin, std::size_t end)
+            {
+                std::move(source + begin, source + end, data + begin);
+            }, queueIndex);
+        }
+    }
+
+    /**
+     * @brief Partition moves the elements satisfying pred before the others, keeping their relative
+     * order (like std::stable_partition), and returns the number of elements satisfying pred. pred is
+     * called twice per element. The elements must be default constructible, for the scatter buffer.
+     */
+    template<std::ranges::contiguous_range Range, typename Predicate>
+    std::size_t Partition(Range&& range, Predicate pred, int queueIndex, std::size_t grainSize = 0)
+    {
+        auto* data = std::ranges::data(range);
+        const auto size = static_cast<std::size_t>(std::ranges::size(range));
+        const auto blockSize = GetBlockSize(size, grainSize);
+        if (size <= blockSize || queueIndex == MAIN_QUEUE_INDEX)
+        {
+            return static_cast<std::size_t>(std::stable_partition(data, data + size, pred) - data);
+        }
+        using T = std::remove_cvref_t<decltype(*data)>;
+        // Count the selected elements of each block, then scatter every block at its offsets
+        const auto blockCount = (size + blockSize - 1) / blockSize;
+        std::vector<std::size_t> selectedCounts(blockCount);
+        ForEachBlock(size, blockSize, [data, &selectedCounts, &pred](std::size_t block, std::size_t begin, std::size_t end)
+        {
+            selectedCounts[block] = static_cast<std::size_t>(std::count_if(data + begin, data + end, pred));
+        }, queueIndex);
+        const auto selectedTotal = std::reduce(selectedCounts.begin(), selectedCounts.end(), std::size_t{0});
+        std::exclusive_scan(selectedCounts.begin(), selectedCounts.end(), selectedCounts.begin(), std::size_t{0});
+
+        std::vector<T> buffer(size);
+        ForEachBlock(size, blockSize, [data, &buffer, &selectedCounts, &pred, selectedTotal](std::size_t block, std::size_t begin, std::size_t end)
+        {
+            auto selected = selectedCounts[block];
+            // The rejected elements go after all the selected ones, in order too
+            auto rejected = selectedTotal + begin - selected;
+            for (auto i = begin; i < end; i++)
+            {
+                buffer[pred(data[i]) ? selected++ : rejected++] = std::move(data[i]);
+            }
+        }, queueIndex);
+        ForEachBlock(size, blockSize, [data, &buffer](std::size_t, std::size_t begin, std::size_t end)
+        {
+            std::move(buffer.begin() + static_cast<std::ptrdiff_t>(begin), buffer.begin() + static_cast<std::ptrdiff_t>(end),
+                data + begin);
+        }, queueIndex);
+        return selectedTotal;
+    }
+}
+
+}
+#endif //NEKOLIB_PARALLEL_ALGORITHM_H
@@ -0,0 +1,152 @@
+#ifndef NEKOLIB_PIPELINE_H
+#define NEKOLIB_PIPELINE_H
+
+#include "thread/job_system.h"
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace neko
+{
+
+/**
+ * \brief StageMode tells how many items a pipeline stage processes at once.
+ * SerialInOrder: one at a time, in the order the input produced them.
+ * SerialOutOfOrder: one at a time, in arrival order.
+ * Parallel: any number at once.
+ */
+enum class StageMode
+{
+    SerialInOrder,
+    SerialOutOfOrder,
+    Parallel
+};
+
+/**
+ * \brief PipelineBase runs items through a serial input followed by a chain of stages, like TBB's
+ * parallel_pipeline. Each of the tokenCount tokens carries one item at a time: it reads an item, takes it
+ * through every stage and goes back to the input, so that at most tokenCount items are in flight.
+ * A token keeps going on the same job through the parallel stages. When a serial stage is busy (or, in
+ * order, waits for an earlier item) the token is parked on it, and the token leaving the stage resumes
+ * it with a pooled JobSystem function job, so no job is allocated per item.
+ * If a stage throws, the input stops, the items in flight go through the remaining stages without
+ * running them, and Wait rethrows the first exception.
+ */
+class PipelineBase
+{
+public:
+    explicit PipelineBase(std::size_t tokenCount);
+    virtual ~PipelineBase() = default;
+    PipelineBase(const PipelineBase&) = delete;
+    PipelineBase& operator=(const PipelineBase&) = delete;
+
+    /**
+     * @brief Start runs the pipeline on the workers of queueIndex, the previous run must be done
+     */
+    void Start(int queueIndex, JobScheduler& scheduler = JobSystem::GetScheduler());
+    /**
+     * @brief Wait joins the run (helping the caller's queue if possible) and rethrows the exception of a
+     * failed stage
+     */
+    void Wait();
+    void Run(int queueIndex, JobScheduler& scheduler = JobSystem::GetScheduler())
+    {
+        Start(queueIndex, scheduler);
+        Wait();
+    }
+    [[nodiscard]] bool IsDone() const { return done_.IsDone(); }
+    [[nodiscard]] std::size_t GetTokenCount() const { return tokens_.size(); }
+    /**
+     * @brief GetItemCount is the number of items the input produced in the last run
+     */
+    [[nodiscard]] std::uint64_t GetItemCount() const { return inputSequence_; }
+protected:
+    void AddStageMode(StageMode mode);
+    /**
+     * @brief ReadInput fills the item of token with the next input, called one token at a time
+     * @return false once the input is exhausted
+     */
+    virtual bool ReadInput(std::size_t token) = 0;
+    virtual void RunStage(std::size_t stage, std::size_t token) = 0;
+private:
+    static constexpr std::size_t INPUT_STAGE = 0;
+
+    struct Token
+    {
+        std::size_t stage = INPUT_STAGE;
+        std::uint64_t sequence = 0;
+        // Set when a leaving token handed its serial stage over to this one
+        bool ownsStage = false;
+    };
+    struct Stage
+    {
+        explicit Stage(StageMode stageMode) : mode(stageMode) {}
+
+        StageMode mode;
+        std::mutex mutex;
+        bool isBusy = false;
+        std::uint64_t nextSequence = 0;
+        std::vector<std::size_t> waitingTokens;
+    };
+
+    void RunToken(std::size_t token);
+    /**
+     * @brief TryEnter takes a serial stage, or parks token on it
+     * @return false if token was parked, it is resumed by the token leaving the stage
+     */
+    bool TryEnter(Stage& stage, std::size_t token);
+    void Leave(Stage& stage);
+    void Resume(std::size_t token);
+    void Fail(std::exception_ptr exception);
+
+    std::vector<Token> tokens_;
+    // The input stage first, then the stages in order
+    std::deque<Stage> stages_;
+    JobCounter done_;
+    JobScheduler* scheduler_ = nullptr;
+    int queueIndex_ = MAIN_QUEUE_INDEX;
+    // Only accessed by the token holding the input stage
+    std::uint64_t inputSequence_ = 0;
+    bool isInputDone_ = false;
+    std::atomic<bool> isStopping_{ false };
+    std::mutex exceptionMutex_;
+    std::exception_ptr exception_;
+};
+
+/**
+ * \brief Pipeline is a PipelineBase carrying a T per token. The T of a token is reused from one item to
+ * the next, it holds what the stages pass to each other (decoded data, transformed data...).
+ */
+template<typename T>
+class Pipeline final : public PipelineBase
+{
+public:
+    using InputFunction = std::function<bool(T& item)>;
+    using StageFunction = std::function<void(T& item)>;
+
+    /**
+     * @param input fills the item with the next input, it returns false once there is none left
+     */
+    Pipeline(std::size_t tokenCount, InputFunction input) :
+        PipelineBase(tokenCount), items_(tokenCount), input_(std::move(input)) {}
+
+    Pipeline& AddStage(StageMode mode, StageFunction func)
+    {
+        AddStageMode(mode);
+        stages_.push_back(std::move(func));
+        return *this;
+    }
+protected:
+    bool ReadInput(std::size_t token) override { return input_(items_[token]); }
+    void RunStage(std::size_t stage, std::size_t token) override { stages_[stage](items_[token]); }
+private:
+    std::vector<T> items_;
+    InputFunction input_;
+    std::vector<StageFunction> stages_;
+};
+
+}
+#endif //NEKOLIB_PIPELINE_H
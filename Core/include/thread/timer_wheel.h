@@ -0,0 +1,111 @@
+#ifndef NEKOLIB_TIMER_WHEEL_H
+#define NEKOLIB_TIMER_WHEEL_H
+
+#include "thread/job_system.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace neko
+{
+
+struct ExpiredTimer
+{
+    Job* job = nullptr;
+    int queueIndex = MAIN_QUEUE_INDEX;
+    JobPriority priority = JobPriority::Normal;
+    // A periodic timer that already fired, its previous run may not be done yet
+    bool isRepeat = false;
+};
+
+/**
+ * \brief TimerWheel is a hierarchical timing wheel: LEVEL_COUNT wheels of SLOT_COUNT slots, each level
+ * counting SLOT_COUNT times slower than the one below. A timer goes to the level of the highest tick
+ * digit where its due tick differs from the current one, and cascades down as the current tick catches
+ * up, so Add and Cancel are O(1). Advance jumps from one occupied slot to the next instead of walking
+ * every tick. Timers further than the top level go to an overflow list, put back at every top level
+ * wrap. It is not thread-safe, the JobScheduler guards it with its timer mutex.
+ */
+class TimerWheel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr std::size_t SLOT_BITS = 6;
+    static constexpr std::size_t SLOT_COUNT = 1u << SLOT_BITS;
+    static constexpr std::size_t LEVEL_COUNT = 4;
+
+    explicit TimerWheel(Clock::duration tickDuration = std::chrono::milliseconds(1), Clock::time_point start = Clock::now());
+
+    /**
+     * @brief Add registers job to be added to queueIndex once dueTime is reached, never before. A non-zero
+     * period re-arms the timer every period after it, measured from the due times so that it does not drift.
+     * @return the id to cancel the timer, never INVALID_TIMER_ID
+     */
+    TimerId Add(Job* job, Clock::time_point dueTime, Clock::duration period = Clock::duration::zero(),
+        int queueIndex = MAIN_QUEUE_INDEX, JobPriority priority = JobPriority::Normal);
+    /**
+     * @brief Cancel removes a pending timer
+     * @return false if it already expired (and was not periodic) or was cancelled
+     */
+    bool Cancel(TimerId timerId);
+    /**
+     * @brief Advance moves the wheel to now and appends the timers due until then to expired, in due order
+     * for the timers of different ticks
+     */
+    void Advance(Clock::time_point now, std::vector<ExpiredTimer>& expired);
+    /**
+     * @brief GetNextDeadline is when Advance has something to do next, an expiry or a cascade, nullopt
+     * when there is no timer
+     */
+    [[nodiscard]] std::optional<Clock::time_point> GetNextDeadline() const;
+    [[nodiscard]] std::size_t GetCount() const { return count_; }
+    [[nodiscard]] bool IsEmpty() const { return count_ == 0; }
+private:
+    static constexpr std::uint32_t NONE = 0xFFFFFFFFu;
+    static constexpr std::size_t OVERFLOW_LIST = LEVEL_COUNT * SLOT_COUNT;
+
+    struct Timer
+    {
+        Job* job = nullptr;
+        std::uint64_t dueTick = 0;
+        std::uint64_t periodTicks = 0;
+        int queueIndex = MAIN_QUEUE_INDEX;
+        JobPriority priority = JobPriority::Normal;
+        bool isRepeat = false;
+        // Bumped on release, so that a stale id cannot cancel the next timer of the slot
+        std::uint32_t generation = 1;
+        std::uint32_t list = NONE;
+        std::uint32_t previous = NONE;
+        std::uint32_t next = NONE;
+    };
+
+    void Insert(std::uint32_t index);
+    void Unlink(std::uint32_t index);
+    void Release(std::uint32_t index);
+    /**
+     * @brief Reinsert empties a list and inserts its timers again, relative to the current tick
+     */
+    void Reinsert(std::size_t list);
+    /**
+     * @brief ProcessTick cascades and expires the current tick, nowTick being where Advance stops
+     */
+    void ProcessTick(std::uint64_t nowTick, std::vector<ExpiredTimer>& expired);
+    [[nodiscard]] std::uint64_t GetNextEventTick() const;
+    [[nodiscard]] Clock::time_point GetTickTime(std::uint64_t tick) const { return start_ + tickDuration_ * tick; }
+
+    Clock::duration tickDuration_;
+    Clock::time_point start_;
+    std::uint64_t currentTick_ = 0;
+    std::size_t count_ = 0;
+    std::vector<Timer> timers_;
+    std::uint32_t freeList_ = NONE;
+    std::array<std::uint32_t, OVERFLOW_LIST + 1> heads_{};
+    // One bit per non-empty slot, to find the next occupied slot without scanning
+    std::array<std::uint64_t, LEVEL_COUNT> occupied_{};
+};
+
+}
+#endif //NEKOLIB_TIMER_WHEEL_H
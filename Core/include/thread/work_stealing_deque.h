@@ -0,0 +1,167 @@
+#ifndef NEKOLIB_WORK_STEALING_DEQUE_H
+#define NEKOLIB_WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace neko
+{
+
+/**
+ * \brief WorkStealingDeque is a Chase-Lev deque (with the C11 memory orderings of Le et al., 2013).
+ * The owner thread pushes and pops at the bottom (LIFO) without contention, any other thread steals
+ * from the top (FIFO) with a single CAS.
+ *
+ * Only the owner may call Push and Pop. Steal and IsEmpty are safe from any thread.
+ * T must be trivially copyable (it is stored in std::atomic), in practice a pointer.
+ */
+template<typename T>
+class WorkStealingDeque
+{
+public:
+    explicit WorkStealingDeque(std::int64_t initialCapacity = 256);
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    void Push(T item);
+    bool Pop(T& out);
+    bool Steal(T& out);
+    [[nodiscard]] bool IsEmpty() const;
+    [[nodiscard]] std::int64_t SizeApprox() const;
+private:
+    class Array
+    {
+    public:
+        explicit Array(std::int64_t capacity) : capacity_(capacity), mask_(capacity - 1),
+            buffer_(std::make_unique<std::atomic<T>[]>(static_cast<std::size_t>(capacity))) {}
+        [[nodiscard]] std::int64_t Capacity() const { return capacity_; }
+        void Put(std::int64_t index, T item)
+        {
+            buffer_[static_cast<std::size_t>(index & mask_)].store(item, std::memory_order_relaxed);
+        }
+        T Get(std::int64_t index) const
+        {
+            return buffer_[static_cast<std::size_t>(index & mask_)].load(std::memory_order_relaxed);
+        }
+    private:
+        std::int64_t capacity_;
+        std::int64_t mask_;
+        std::unique_ptr<std::atomic<T>[]> buffer_;
+    };
+    Array* Grow(Array* array, std::int64_t top, std::int64_t bottom);
+
+    alignas(64) std::atomic<std::int64_t> top_{0};
+    alignas(64) std::atomic<std::int64_t> bottom_{0};
+    std::atomic<Array*> array_{nullptr};
+    // Thieves may still be reading an old buffer after a Grow, so retired arrays are kept alive
+    // until the deque itself is destroyed. Capacities double, so this is bounded by twice the peak.
+    std::vector<std::unique_ptr<Array>> arrays_;
+};
+
+template<typename T>
+WorkStealingDeque<T>::WorkStealingDeque(std::int64_t initialCapacity)
+{
+    std::int64_t capacity = 1;
+    while (capacity < initialCapacity)
+    {
+        capacity <<= 1;
+    }
+    arrays_.push_back(std::make_unique<Array>(capacity));
+    array_.store(arrays_.back().get(), std::memory_order_relaxed);
+}
+
+template<typename T>
+void WorkStealingDeque<T>::Push(T item)
+{
+    const auto bottom = bottom_.load(std::memory_order_relaxed);
+    const auto top = top_.load(std::memory_order_acquire);
+    auto* array = array_.load(std::memory_order_relaxed);
+    if (bottom - top > array->Capacity() - 1)
+    {
+        array = Grow(array, top, bottom);
+    }
+    array->Put(bottom, item);
+    // A release store rather than the paper's release fence: same code on x86 and ARMv8, and visible
+    // to ThreadSanitizer which does not model fences
+    bottom_.store(bottom + 1, std::memory_order_release);
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::Pop(T& out)
+{
+    const auto bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    auto* array = array_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto top = top_.load(std::memory_order_relaxed);
+    if (top > bottom)
+    {
+        // Empty, restore the canonical bottom.
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return false;
+    }
+    out = array->Get(bottom);
+    if (top == bottom)
+    {
+        // Last item, race the thieves for it.
+        const bool won = top_.compare_exchange_strong(top, top + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::Steal(T& out)
+{
+    auto top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const auto bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom)
+    {
+        return false;
+    }
+    auto* array = array_.load(std::memory_order_acquire);
+    T item = array->Get(top);
+    if (!top_.compare_exchange_strong(top, top + 1,
+        std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+        return false;
+    }
+    out = item;
+    return true;
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::IsEmpty() const
+{
+    return SizeApprox() <= 0;
+}
+
+template<typename T>
+std::int64_t WorkStealingDeque<T>::SizeApprox() const
+{
+    const auto bottom = bottom_.load(std::memory_order_relaxed);
+    const auto top = top_.load(std::memory_order_relaxed);
+    return bottom - top;
+}
+
+template<typename T>
+typename WorkStealingDeque<T>::Array* WorkStealingDeque<T>::Grow(Array* array, std::int64_t top, std::int64_t bottom)
+{
+    auto newArray = std::make_unique<Array>(array->Capacity() * 2);
+    for (auto i = top; i < bottom; i++)
+    {
+        newArray->Put(i, array->Get(i));
+    }
+    auto* result = newArray.get();
+    arrays_.push_back(std::move(newArray));
+    array_.store(result, std::memory_order_release);
+    return result;
+}
+
+}
+#endif //NEKOLIB_WORK_STEALING_DEQUE_H
@@ -0,0 +1,136 @@
+#ifndef NEKOLIB_PROFILER_H
+#define NEKOLIB_PROFILER_H
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define NEKO_PROFILER_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define NEKO_PROFILER_RDTSC 1
+#endif
+
+namespace neko::Profiler
+{
+
+/**
+ * \brief Event is one closed zone. The name is not copied, it must outlive the export (a string literal).
+ */
+struct Event
+{
+    const char* name = nullptr;
+    std::uint64_t begin = 0;
+    std::uint64_t end = 0;
+};
+
+/**
+ * \brief ThreadBuffer is the single producer single consumer ring of a thread: only its thread pushes,
+ * only the export pops. When the export does not keep up, the newest events are dropped and counted
+ * instead of blocking the thread.
+ */
+class ThreadBuffer
+{
+public:
+    static constexpr std::size_t CAPACITY = 1u << 14;
+
+    void Push(const Event& event)
+    {
+        const auto head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= CAPACITY)
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        events_[head & (CAPACITY - 1)] = event;
+        head_.store(head + 1, std::memory_order_release);
+    }
+private:
+    friend class Registry;
+
+    std::array<Event, CAPACITY> events_{};
+    alignas(64) std::atomic<std::uint64_t> head_{0};
+    alignas(64) std::atomic<std::uint64_t> tail_{0};
+    std::atomic<std::uint64_t> dropped_{0};
+};
+
+/**
+ * \brief Now is the profiler clock: the time stamp counter where there is one, converted to nanoseconds
+ * at export only, steady_clock elsewhere
+ */
+inline std::uint64_t Now()
+{
+#ifdef NEKO_PROFILER_RDTSC
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+/**
+ * \brief GetThreadBuffer returns the ring of the calling thread, registering it on first use
+ */
+ThreadBuffer& GetThreadBuffer();
+
+/**
+ * \brief SetThreadName names the calling thread in the exported trace, the name is copied
+ */
+void SetThreadName(std::string_view name);
+
+/**
+ * \brief WriteChromeTrace drains the events of every thread into out, as a Chrome trace event JSON
+ * that chrome://tracing and Perfetto open. Drained events are not exported again.
+ * @return the number of zones written
+ */
+std::size_t WriteChromeTrace(std::ostream& out);
+/**
+ * \brief ExportChromeTrace writes the Chrome trace to the file at path
+ * @return false if the file could not be written
+ */
+bool ExportChromeTrace(std::string_view path);
+/**
+ * \brief Clear drops the pending events of every thread
+ */
+void Clear();
+/**
+ * \brief GetDroppedCount is the number of zones lost to full rings since the start
+ */
+std::uint64_t GetDroppedCount();
+
+/**
+ * \brief ScopedZone records the zone from its construction to its destruction in the thread ring.
+ * Prefer the NEKO_PROFILE_ZONE macro, compiled out without NEKO_PROFILER_ENABLE.
+ */
+class ScopedZone
+{
+public:
+    explicit ScopedZone(const char* name) : buffer_(GetThreadBuffer()), name_(name), begin_(Now()) {}
+    ~ScopedZone() { buffer_.Push({name_, begin_, Now()}); }
+    ScopedZone(const ScopedZone&) = delete;
+    ScopedZone& operator=(const ScopedZone&) = delete;
+private:
+    ThreadBuffer& buffer_;
+    const char* name_;
+    std::uint64_t begin_;
+};
+
+}
+
+#define NEKO_PROFILER_CONCAT_IMPL(a, b) a##b
+#define NEKO_PROFILER_CONCAT(a, b) NEKO_PROFILER_CONCAT_IMPL(a, b)
+
+#ifdef NEKO_PROFILER_ENABLE
+#define NEKO_PROFILE_ZONE(name) const ::neko::Profiler::ScopedZone NEKO_PROFILER_CONCAT(nekoProfileZone, __LINE__){name}
+#define NEKO_PROFILE_THREAD_NAME(name) ::neko::Profiler::SetThreadName(name)
+#else
+#define NEKO_PROFILE_ZONE(name) static_cast<void>(0)
+#define NEKO_PROFILE_THREAD_NAME(name) static_cast<void>(0)
+#endif
+
+#endif //NEKOLIB_PROFILER_H
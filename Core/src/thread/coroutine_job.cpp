@@ -0,0 +1,88 @@
+#include "thread/coroutine_job.h"
+
+#ifdef TRACY_ENABLE
+#include <tracy/Tracy.hpp>
+#endif
+#include <algorithm>
+
+namespace neko
+{
+
+JobTask& JobTask::operator=(JobTask&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+        handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+}
+
+JobTask::~JobTask()
+{
+    if (handle_)
+    {
+        handle_.destroy();
+    }
+}
+
+CoroutineJob::CoroutineJob(JobTask task) : task_(std::move(task))
+{
+    if (task_.handle_)
+    {
+        task_.handle_.promise().job_ = this;
+    }
+}
+
+void CoroutineJob::Execute()
+{
+#ifdef TRACY_ENABLE
+    ZoneScoped;
+#endif
+    auto handle = task_.handle_;
+    if (!HasStarted())
+    {
+        if (IsCancelled() || !handle || handle.done())
+        {
+            SkipAsFailed();
+            return;
+        }
+        MarkStarted();
+    }
+    // Nothing may touch this job after resume: once suspended, the coroutine can already be resumed
+    // by another worker, and once finished, it can already be destroyed by a joining thread.
+    handle.resume();
+}
+
+void CoroutineJob::Finish(bool failed)
+{
+    MarkDone(failed);
+}
+
+CoroutineJob::JobsAwaiter::JobsAwaiter(CoroutineJob* self, std::span<Job* const> jobs) : self_(self)
+{
+    links_.reserve(jobs.size());
+    for (auto* job : jobs)
+    {
+        links_.push_back({job, self});
+    }
+}
+
+bool CoroutineJob::JobsAwaiter::await_ready() const
+{
+    return std::ranges::all_of(links_, [](const auto& link)
+    {
+        return link.dependency == nullptr || link.dependency->IsDone();
+    });
+}
+
+void CoroutineJob::FinalAwaiter::await_suspend(std::coroutine_handle<JobTask::promise_type> handle) noexcept
+{
+    auto& promise = handle.promise();
+    promise.job_->Finish(promise.failed_);
+}
+
+}
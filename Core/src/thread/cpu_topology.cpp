@@ -0,0 +1,304 @@
+#include "thread/cpu_topology.h"
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace neko
+{
+
+namespace
+{
+#if defined(__linux__)
+bool ReadFile(const std::filesystem::path& path, std::string& content)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+    std::getline(file, content);
+    return true;
+}
+
+int ReadInt(const std::filesystem::path& path, int defaultValue)
+{
+    std::string content;
+    int value = defaultValue;
+    if (ReadFile(path, content))
+    {
+        std::from_chars(content.data(), content.data() + content.size(), value);
+    }
+    return value;
+}
+#endif
+}
+
+CpuTopology::CpuTopology(std::vector<CpuInfo> cpus) : cpus_(std::move(cpus))
+{
+    std::ranges::sort(cpus_, {}, &CpuInfo::cpu);
+}
+
+const CpuTopology& CpuTopology::Get()
+{
+    static const CpuTopology topology = Read();
+    return topology;
+}
+
+CpuTopology CpuTopology::Read()
+{
+    std::vector<CpuInfo> cpus;
+#if defined(__linux__)
+    const std::filesystem::path cpuRoot = "/sys/devices/system/cpu";
+    std::string content;
+    if (ReadFile(cpuRoot / "online", content))
+    {
+        std::vector<std::pair<int, int>> packageCores;
+        for (const auto cpu : ParseCpuList(content))
+        {
+            const auto cpuPath = cpuRoot / ("cpu" + std::to_string(cpu));
+            CpuInfo info{};
+            info.cpu = cpu;
+            info.package = ReadInt(cpuPath / "topology" / "physical_package_id", 0);
+            // core_id is only unique within a package, so number the (package, core_id) pairs instead
+            const std::pair packageCore{info.package, ReadInt(cpuPath / "topology" / "core_id", cpu)};
+            auto it = std::ranges::find(packageCores, packageCore);
+            info.core = static_cast<int>(it - packageCores.begin());
+            if (it == packageCores.end())
+            {
+                packageCores.push_back(packageCore);
+            }
+            info.cacheDomain = cpu;
+            std::error_code error;
+            for (const auto& cacheEntry : std::filesystem::directory_iterator(cpuPath / "cache", error))
+            {
+                if (ReadInt(cacheEntry.path() / "level", 0) == 3 &&
+                    ReadFile(cacheEntry.path() / "shared_cpu_list", content))
+                {
+                    const auto sharedCpus = ParseCpuList(content);
+                    if (!sharedCpus.empty())
+                    {
+                        info.cacheDomain = sharedCpus.front();
+                    }
+                }
+            }
+            for (const auto& entry : std::filesystem::directory_iterator(cpuPath, error))
+            {
+                const auto name = entry.path().filename().string();
+                if (name.starts_with("node"))
+                {
+                    std::from_chars(name.data() + 4, name.data() + name.size(), info.numaNode);
+                }
+            }
+            cpus.push_back(info);
+        }
+    }
+#endif
+    if (cpus.empty())
+    {
+        const auto cpuCount = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < cpuCount; i++)
+        {
+            const auto cpu = static_cast<int>(i);
+            cpus.push_back({cpu, 0, cpu, 0, 0});
+        }
+    }
+    return CpuTopology{std::move(cpus)};
+}
+
+std::vector<int> CpuTopology::GetPhysicalCores() const
+{
+    std::vector<CpuInfo> firstSiblings;
+    for (const auto& info : cpus_)
+    {
+        if (std::ranges::find(firstSiblings, info.core, &CpuInfo::core) == firstSiblings.end())
+        {
+            firstSiblings.push_back(info);
+        }
+    }
+    std::ranges::stable_sort(firstSiblings, {}, &CpuInfo::package);
+    std::vector<int> result;
+    result.reserve(firstSiblings.size());
+    for (const auto& info : firstSiblings)
+    {
+        result.push_back(info.cpu);
+    }
+    return result;
+}
+
+std::vector<int> CpuTopology::GetCacheDomainCpus(int cacheDomain) const
+{
+    std::vector<int> result;
+    for (const auto& info : cpus_)
+    {
+        if (info.cacheDomain == cacheDomain)
+        {
+            result.push_back(info.cpu);
+        }
+    }
+    return result;
+}
+
+std::vector<int> CpuTopology::GetNumaNodeCpus(int numaNode) const
+{
+    std::vector<int> result;
+    for (const auto& info : cpus_)
+    {
+        if (info.numaNode == numaNode)
+        {
+            result.push_back(info.cpu);
+        }
+    }
+    return result;
+}
+
+std::vector<int> CpuTopology::ParseCpuList(std::string_view cpuList)
+{
+    std::vector<int> result;
+    while (!cpuList.empty())
+    {
+        const auto comma = cpuList.find(',');
+        const auto range = cpuList.substr(0, comma);
+        cpuList = comma == std::string_view::npos ? std::string_view{} : cpuList.substr(comma + 1);
+
+        int first = 0;
+        const auto [end, error] = std::from_chars(range.data(), range.data() + range.size(), first);
+        if (error != std::errc{})
+        {
+            continue;
+        }
+        int last = first;
+        if (end != range.data() + range.size() && *end == '-')
+        {
+            std::from_chars(end + 1, range.data() + range.size(), last);
+        }
+        for (int cpu = first; cpu <= last; cpu++)
+        {
+            result.push_back(cpu);
+        }
+    }
+    return result;
+}
+
+AffinityPolicy AffinityPolicy::CpuSets(std::vector<std::vector<int>> cpuSets)
+{
+    AffinityPolicy policy;
+    policy.type_ = Type::CpuSets;
+    policy.cpuSets_ = std::move(cpuSets);
+    return policy;
+}
+
+AffinityPolicy AffinityPolicy::PhysicalCores()
+{
+    AffinityPolicy policy;
+    policy.type_ = Type::PhysicalCores;
+    return policy;
+}
+
+AffinityPolicy AffinityPolicy::CacheDomain(int cpu)
+{
+    AffinityPolicy policy;
+    policy.type_ = Type::CacheDomain;
+    policy.domain_ = cpu;
+    return policy;
+}
+
+AffinityPolicy AffinityPolicy::NumaNode(int numaNode)
+{
+    AffinityPolicy policy;
+    policy.type_ = Type::NumaNode;
+    policy.domain_ = numaNode;
+    return policy;
+}
+
+std::vector<std::vector<int>> AffinityPolicy::Assign(const CpuTopology& topology, int threadCount) const
+{
+    std::vector<std::vector<int>> result(static_cast<std::size_t>(std::max(threadCount, 0)));
+    switch (type_)
+    {
+    case Type::None:
+        break;
+    case Type::CpuSets:
+    {
+        if (cpuSets_.empty())
+        {
+            break;
+        }
+        for (std::size_t i = 0; i < result.size(); i++)
+        {
+            result[i] = cpuSets_[i % cpuSets_.size()];
+        }
+        break;
+    }
+    case Type::PhysicalCores:
+    {
+        const auto cores = topology.GetPhysicalCores();
+        if (cores.empty())
+        {
+            break;
+        }
+        for (std::size_t i = 0; i < result.size(); i++)
+        {
+            result[i] = {cores[i % cores.size()]};
+        }
+        break;
+    }
+    case Type::CacheDomain:
+    case Type::NumaNode:
+    {
+        std::vector<int> cpus;
+        if (type_ == Type::CacheDomain)
+        {
+            const auto& topologyCpus = topology.GetCpus();
+            const auto it = std::ranges::find(topologyCpus, domain_, &CpuInfo::cpu);
+            if (it != topologyCpus.end())
+            {
+                cpus = topology.GetCacheDomainCpus(it->cacheDomain);
+            }
+        }
+        else
+        {
+            cpus = topology.GetNumaNodeCpus(domain_);
+        }
+        for (auto& cpuSet : result)
+        {
+            cpuSet = cpus;
+        }
+        break;
+    }
+    }
+    return result;
+}
+
+bool SetCurrentThreadAffinity(const std::vector<int>& cpus)
+{
+#if defined(__linux__)
+    if (cpus.empty())
+    {
+        return false;
+    }
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (const auto cpu : cpus)
+    {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+        {
+            CPU_SET(static_cast<std::size_t>(cpu), &cpuSet);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+    static_cast<void>(cpus);
+    return false;
+#endif
+}
+
+}
@@ -0,0 +1,142 @@
+#include "thread/duration_history.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace neko
+{
+
+DurationHistory::DurationHistory() : entries_(std::make_unique<Entry[]>(CAPACITY))
+{
+}
+
+void DurationHistory::Record(DurationKey key, std::chrono::nanoseconds duration)
+{
+    auto* entry = FindOrInsert(key);
+    if (entry == nullptr)
+    {
+        return;
+    }
+    const auto sample = static_cast<std::int64_t>(duration.count());
+    entry->sampleCount.fetch_add(1, std::memory_order_relaxed);
+    // A single compare-exchange loop for the first sample too, so that concurrent first samples are
+    // all folded in instead of one of them overwriting the others
+    auto average = entry->average.load(std::memory_order_relaxed);
+    while (!entry->average.compare_exchange_weak(average,
+        average == EMPTY_AVERAGE ? sample : average + (sample - average) / (1 << SMOOTHING_SHIFT),
+        std::memory_order_relaxed))
+    {
+    }
+}
+
+std::chrono::nanoseconds DurationHistory::GetExpectedDuration(DurationKey key) const
+{
+    const auto* entry = Find(key);
+    if (entry == nullptr)
+    {
+        return std::chrono::nanoseconds::zero();
+    }
+    const auto average = entry->average.load(std::memory_order_relaxed);
+    return std::chrono::nanoseconds(average == EMPTY_AVERAGE ? 0 : average);
+}
+
+std::vector<DurationRecord> DurationHistory::Export() const
+{
+    std::vector<DurationRecord> records;
+    for (std::size_t i = 0; i < CAPACITY; i++)
+    {
+        const auto& entry = entries_[i];
+        const auto key = entry.key.load(std::memory_order_acquire);
+        const auto average = entry.average.load(std::memory_order_relaxed);
+        if (key != NO_DURATION_KEY && average != EMPTY_AVERAGE)
+        {
+            records.push_back({key, std::chrono::nanoseconds(average),
+                std::max<std::uint64_t>(1, entry.sampleCount.load(std::memory_order_relaxed))});
+        }
+    }
+    return records;
+}
+
+void DurationHistory::Import(std::span<const DurationRecord> records)
+{
+    for (const auto& record : records)
+    {
+        auto* entry = FindOrInsert(record.key);
+        if (entry == nullptr || record.sampleCount == 0)
+        {
+            continue;
+        }
+        entry->average.store(static_cast<std::int64_t>(record.average.count()), std::memory_order_relaxed);
+        entry->sampleCount.store(record.sampleCount, std::memory_order_relaxed);
+    }
+}
+
+void DurationHistory::Clear()
+{
+    for (std::size_t i = 0; i < CAPACITY; i++)
+    {
+        entries_[i].key.store(NO_DURATION_KEY, std::memory_order_relaxed);
+        entries_[i].average.store(EMPTY_AVERAGE, std::memory_order_relaxed);
+        entries_[i].sampleCount.store(0, std::memory_order_relaxed);
+    }
+}
+
+const DurationHistory::Entry* DurationHistory::Find(DurationKey key) const
+{
+    if (key == NO_DURATION_KEY)
+    {
+        return nullptr;
+    }
+    auto slot = GetSlot(key);
+    for (std::size_t probe = 0; probe < MAX_PROBE_COUNT; probe++)
+    {
+        const auto& entry = entries_[slot];
+        const auto entryKey = entry.key.load(std::memory_order_acquire);
+        if (entryKey == key)
+        {
+            return &entry;
+        }
+        // Keys are never removed one by one, an empty slot ends the probe sequence
+        if (entryKey == NO_DURATION_KEY)
+        {
+            return nullptr;
+        }
+        slot = (slot + 1) & (CAPACITY - 1);
+    }
+    return nullptr;
+}
+
+DurationHistory::Entry* DurationHistory::FindOrInsert(DurationKey key)
+{
+    if (key == NO_DURATION_KEY)
+    {
+        return nullptr;
+    }
+    auto slot = GetSlot(key);
+    for (std::size_t probe = 0; probe < MAX_PROBE_COUNT; probe++)
+    {
+        auto& entry = entries_[slot];
+        auto entryKey = entry.key.load(std::memory_order_acquire);
+        if (entryKey == NO_DURATION_KEY &&
+            entry.key.compare_exchange_strong(entryKey, key, std::memory_order_acq_rel))
+        {
+            return &entry;
+        }
+        // Either the slot already held key, or another thread just claimed it, maybe for key
+        if (entryKey == key)
+        {
+            return &entry;
+        }
+        slot = (slot + 1) & (CAPACITY - 1);
+    }
+    return nullptr;
+}
+
+std::size_t DurationHistory::GetSlot(DurationKey key)
+{
+    // Fibonacci hashing, keys are often small consecutive integers
+    constexpr auto shift = 32 - std::countr_zero(CAPACITY);
+    return static_cast<std::size_t>((static_cast<std::uint32_t>(key) * 2654435769u) >> shift);
+}
+
+}
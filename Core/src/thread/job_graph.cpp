@@ -0,0 +1,289 @@
+#include "thread/job_graph.h"
+
+#ifdef TRACY_ENABLE
+#include <tracy/Tracy.hpp>
+#endif
+#include <algorithm>
+#include <stdexcept>
+
+namespace neko
+{
+
+JobGraph::NodeIndex JobGraph::AddNode(Job* job, int queueIndex)
+{
+    if (!IsDone())
+    {
+        throw std::logic_error("JobGraph node added while a run is not done");
+    }
+    isCompiled_ = false;
+    nodes_.push_back({job, queueIndex});
+    return nodes_.size() - 1;
+}
+
+void JobGraph::AddEdge(NodeIndex from, NodeIndex to)
+{
+    if (from >= nodes_.size() || to >= nodes_.size())
+    {
+        throw std::out_of_range("JobGraph edge to a node that was not added");
+    }
+    if (!IsDone())
+    {
+        throw std::logic_error("JobGraph edge added while a run is not done");
+    }
+    isCompiled_ = false;
+    edges_.emplace_back(from, to);
+}
+
+bool JobGraph::Compile()
+{
+#ifdef TRACY_ENABLE
+    ZoneScoped;
+#endif
+    // The nodes of a run in flight still read the successors and the counters
+    if (!IsDone())
+    {
+        return false;
+    }
+    const auto nodeCount = nodes_.size();
+    // Successors as one flat array, sorted by source node
+    std::ranges::sort(edges_);
+    successors_.clear();
+    successors_.reserve(edges_.size());
+    for (auto& node : nodes_)
+    {
+        node.predecessorCount = 0;
+        node.level = 0;
+    }
+    std::size_t edgeIndex = 0;
+    for (NodeIndex i = 0; i < nodeCount; i++)
+    {
+        nodes_[i].successorsBegin = successors_.size();
+        for (; edgeIndex < edges_.size() && edges_[edgeIndex].first == i; edgeIndex++)
+        {
+            const auto to = edges_[edgeIndex].second;
+            successors_.push_back(to);
+            nodes_[to].predecessorCount++;
+        }
+        nodes_[i].successorsEnd = successors_.size();
+    }
+
+    // Kahn's algorithm, a node left unvisited is on a cycle
+    std::vector<int> remainingPredecessors(nodeCount);
+    std::vector<NodeIndex> ready;
+    for (NodeIndex i = 0; i < nodeCount; i++)
+    {
+        remainingPredecessors[i] = nodes_[i].predecessorCount;
+        if (remainingPredecessors[i] == 0)
+        {
+            ready.push_back(i);
+        }
+    }
+    std::size_t visitedCount = 0;
+    while (!ready.empty())
+    {
+        const auto current = ready.back();
+        ready.pop_back();
+        visitedCount++;
+        const auto& node = nodes_[current];
+        for (auto i = node.successorsBegin; i < node.successorsEnd; i++)
+        {
+            auto& successor = nodes_[successors_[i]];
+            successor.level = std::max(successor.level, node.level + 1);
+            if (--remainingPredecessors[successors_[i]] == 0)
+            {
+                ready.push_back(successors_[i]);
+            }
+        }
+    }
+    if (visitedCount != nodeCount)
+    {
+        isCompiled_ = false;
+        return false;
+    }
+
+    nodeJobs_ = std::make_unique<NodeJob[]>(nodeCount);
+    // Value-initialized, the counters start from zero with the run number
+    finishedPredecessors_ = std::make_unique<std::atomic<std::uint64_t>[]>(nodeCount);
+    failedRun_ = std::make_unique<std::atomic<std::uint64_t>[]>(nodeCount);
+    run_ = 0;
+    roots_.clear();
+    mainSuccessorCount_ = 0;
+    for (NodeIndex i = 0; i < nodeCount; i++)
+    {
+        nodeJobs_[i].graph_ = this;
+        nodeJobs_[i].index_ = i;
+        if (nodes_[i].predecessorCount != 0)
+        {
+            if (nodes_[i].queueIndex == MAIN_QUEUE_INDEX)
+            {
+                mainSuccessorCount_++;
+            }
+            continue;
+        }
+        auto it = std::ranges::find(roots_, nodes_[i].queueIndex, &RootBatch::queueIndex);
+        if (it == roots_.end())
+        {
+            roots_.push_back({nodes_[i].queueIndex, {}});
+            it = roots_.end() - 1;
+        }
+        it->jobs.push_back(&nodeJobs_[i]);
+    }
+    isCompiled_ = true;
+    return true;
+}
+
+void JobGraph::Run(JobScheduler& scheduler)
+{
+#ifdef TRACY_ENABLE
+    ZoneScoped;
+#endif
+    if (!isCompiled_ || nodes_.empty())
+    {
+        return;
+    }
+    // Resetting the counters of a graph in flight would lose or run nodes twice
+    if (!IsDone())
+    {
+        throw std::logic_error("JobGraph run while its previous run is not done");
+    }
+    // The only reset of a run, the node counters keep counting from the previous runs
+    run_++;
+    scheduler_ = &scheduler;
+    hasFailed_.store(false, std::memory_order_relaxed);
+    isDone_.store(false, std::memory_order_relaxed);
+    // Released by the enqueue of the roots
+    remainingNodes_.store(nodes_.size(), std::memory_order_release);
+    // The main queue successors are only added once ready, until then the main thread must still know
+    // it has work coming, or it would stop helping and block in Join while nobody can run them
+    scheduler.ReserveMainThreadJobs(mainSuccessorCount_);
+    for (const auto& rootBatch : roots_)
+    {
+        scheduler.AddJobs(rootBatch.jobs, rootBatch.queueIndex);
+    }
+}
+
+void JobGraph::Join() const
+{
+    // Helping runs the main thread nodes when joined from the main thread, instead of waiting forever
+    if (scheduler_ != nullptr)
+    {
+        scheduler_->HelpWhileWaiting(
+            [](const void* graph) { return static_cast<const JobGraph*>(graph)->IsDone(); }, this);
+    }
+    while (!IsDone())
+    {
+        isDone_.wait(false, std::memory_order_acquire);
+    }
+}
+
+void JobGraph::ExecuteNode(NodeIndex index, bool isResumed)
+{
+    // A ready successor on the same queue runs next here instead of going through the scheduler
+    auto nextIndex = index;
+    do
+    {
+        index = nextIndex;
+        nextIndex = nodes_.size();
+        auto* job = nodes_[index].job;
+        if (!isResumed)
+        {
+            job->Reset();
+            // A suspended coroutine is dispatched again through these, like a job added to the node queue
+            job->scheduler_ = scheduler_;
+            job->queueIndex_ = nodes_[index].queueIndex;
+            if (failedRun_[index].load(std::memory_order_relaxed) == run_)
+            {
+                job->SkipAsFailed();
+            }
+            else
+            {
+                job->Execute();
+            }
+            if (!job->IsDone() && WaitForNode(index))
+            {
+                return;
+            }
+        }
+        isResumed = false;
+        const bool failed = job->HasFailed();
+        if (failed)
+        {
+            hasFailed_.store(true, std::memory_order_relaxed);
+        }
+        const auto& node = nodes_[index];
+        for (auto i = node.successorsBegin; i < node.successorsEnd; i++)
+        {
+            const auto successor = successors_[i];
+            if (failed)
+            {
+                // Published to the successor by the release of its counter
+                failedRun_[successor].store(run_, std::memory_order_relaxed);
+            }
+            const auto readyCount = run_ * static_cast<std::uint64_t>(nodes_[successor].predecessorCount);
+            if (finishedPredecessors_[successor].fetch_add(1, std::memory_order_acq_rel) + 1 != readyCount)
+            {
+                continue;
+            }
+            if (nextIndex == nodes_.size() && nodes_[successor].queueIndex == node.queueIndex)
+            {
+                nextIndex = successor;
+                continue;
+            }
+            DispatchNode(successor);
+        }
+        if (nextIndex != nodes_.size() && nodes_[nextIndex].queueIndex == MAIN_QUEUE_INDEX)
+        {
+            // Run here on the main thread, its reservation is not needed anymore
+            scheduler_->ReserveMainThreadJobs(-1);
+        }
+        if (remainingNodes_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            // Read before publishing, Run may start again right after
+            auto* scheduler = scheduler_;
+            isDone_.store(true, std::memory_order_release);
+            isDone_.notify_all();
+            // A main thread joining the graph may be parked in HelpWhileWaiting
+            scheduler->NotifyWaiters();
+        }
+    } while (nextIndex != nodes_.size());
+}
+
+bool JobGraph::WaitForNode(NodeIndex index)
+{
+    auto& nodeJob = nodeJobs_[index];
+    // Written before the link is armed, the thread releasing it may execute the node job right away
+    nodeJob.isResumed_ = true;
+    nodeJob.scheduler_ = scheduler_;
+    nodeJob.queueIndex_ = nodes_[index].queueIndex;
+    nodeJob.completion_ = {nodes_[index].job, &nodeJob};
+    if (nodeJob.WaitForDependencies({&nodeJob.completion_, 1}))
+    {
+        return true;
+    }
+    nodeJob.isResumed_ = false;
+    return false;
+}
+
+void JobGraph::DispatchNode(NodeIndex index)
+{
+    if (nodes_[index].queueIndex == MAIN_QUEUE_INDEX)
+    {
+        scheduler_->AddReservedMainThreadJob(&nodeJobs_[index]);
+    }
+    else
+    {
+        scheduler_->AddJob(&nodeJobs_[index], nodes_[index].queueIndex);
+    }
+}
+
+void JobGraph::NodeJob::Execute()
+{
+#ifdef TRACY_ENABLE
+    ZoneScoped;
+#endif
+    const bool isResumed = isResumed_;
+    isResumed_ = false;
+    graph_->ExecuteNode(index_, isResumed);
+}
+
+}
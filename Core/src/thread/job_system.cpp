@@ -1,4 +1,9 @@
 #include "thread/job_system.h"
+#include "thread/work_stealing_deque.h"
+#include "thread/cpu_topology.h"
+#include "thread/timer_wheel.h"
+#include "thread/duration_history.h"
+#include "utils/profiler.h"
 #if defined(__clang__)
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wold-style-cast"
@@ -10,7 +15,8 @@
 #define NEKO_DEFINED_UNIX_FOR_CONCURRENTQUEUE
 #define __unix__
 #endif
-#include <blockingconcurrentqueue.h>
+#include <concurrentqueue.h>
+#include <lightweightsemaphore.h>
 #ifdef NEKO_DEFINED_UNIX_FOR_CONCURRENTQUEUE
 #undef __unix__
 #undef NEKO_DEFINED_UNIX_FOR_CONCURRENTQUEUE
@@ -21,51 +27,62 @@
 #pragma GCC diagnostic pop
 #endif
 #include <thread>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
 
 
 #ifdef TRACY_ENABLE
 #include <tracy/Tracy.hpp>
-#include <cstdio>
+#include <string_view>
 #endif
 #include <algorithm>
 #include <ranges>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
 
 namespace neko
 {
 
+Job::DependencyLink Job::closedContinuations_{};
+std::atomic<std::uint64_t> Job::visitEpoch_{0};
+
 void Job::Execute()
 {
 #ifdef TRACY_ENABLE
     ZoneScoped;
 #endif
-    hasStarted_.store(true, std::memory_order_release);
+    NEKO_PROFILE_ZONE("Job::Execute");
     if (IsCancelled())
     {
-        failed_.store(true, std::memory_order_release);
-        isDone_.store(true, std::memory_order_release);
-        isDone_.notify_all();
+        Complete(STARTED | FAILED | CANCELLED);
         return;
     }
+    state_.fetch_or(STARTED, std::memory_order_release);
+    std::uint32_t flags = 0;
     try
     {
         ExecuteImpl();
     }
     catch (...)
     {
-        failed_.store(true, std::memory_order_release);
+        flags = FAILED;
     }
-    isDone_.store(true, std::memory_order_release);
-    isDone_.notify_all();
+    Complete(flags);
 }
 
 bool Job::HasStarted() const
 {
-    return hasStarted_.load(std::memory_order_acquire);
+    return (state_.load(std::memory_order_acquire) & STARTED) != 0;
 }
 
 bool Job::IsDone() const
 {
-    return isDone_.load(std::memory_order_acquire);
+    return (state_.load(std::memory_order_acquire) & DONE) != 0;
 }
 
 bool Job::ShouldStart() const
@@ -75,84 +92,206 @@ bool Job::ShouldStart() const
 
 void Job::Reset()
 {
-    hasStarted_.store(false, std::memory_order_release);
-    isDone_.store(false, std::memory_order_release);
-    failed_.store(false, std::memory_order_release);
+    state_.store(PENDING, std::memory_order_release);
+    // Only reopen a finished list: a job that has not run yet keeps the dependents already waiting on it
+    auto* closed = &closedContinuations_;
+    continuations_.compare_exchange_strong(closed, nullptr, std::memory_order_acq_rel);
 }
 
-bool Job::CheckDependency([[maybe_unused]]const Job *ptr) const
+bool Job::CheckDependency(const Job *ptr) const
 {
+#ifdef TRACY_ENABLE
+    ZoneScoped;
+#endif
+    if (ptr == this)
+    {
+        return true;
+    }
+    // Each walk stamps the jobs it reaches with a new epoch, so that a job shared by several paths
+    // is expanded once: O(V+E) of the upstream graph instead of one visit per path
+    const auto epoch = visitEpoch_.fetch_add(1, std::memory_order_relaxed) + 1;
+    // Iterative, long chains would overflow the stack, and kept per thread to not allocate every call
+    thread_local std::vector<const Job*> stack;
+    stack.clear();
+    visitMark_.store(epoch, std::memory_order_relaxed);
+    stack.push_back(this);
+    while (!stack.empty())
+    {
+        const auto* job = stack.back();
+        stack.pop_back();
+        // The links are only read, GetDependencyLinks is not const for the jobs handing them to the scheduler
+        for (const auto& link : const_cast<Job*>(job)->GetDependencyLinks())
+        {
+            const auto* dependency = link.dependency;
+            if (dependency == nullptr || dependency->visitMark_.load(std::memory_order_relaxed) == epoch)
+            {
+                continue;
+            }
+            if (dependency == ptr)
+            {
+                return true;
+            }
+            dependency->visitMark_.store(epoch, std::memory_order_relaxed);
+            stack.push_back(dependency);
+        }
+    }
     return false;
 }
 
 bool Job::HasFailed() const
 {
-    return failed_.load(std::memory_order_acquire);
+    return (state_.load(std::memory_order_acquire) & FAILED) != 0;
 }
 
 bool Job::IsCancelled() const
 {
-    return cancelFlag_ != nullptr && cancelFlag_->load(std::memory_order_acquire);
+    return (state_.load(std::memory_order_acquire) & CANCELLED) != 0 ||
+        (cancelFlag_ != nullptr && cancelFlag_->load(std::memory_order_acquire));
 }
 
 void Job::SkipAsFailed()
 {
-    hasStarted_.store(true, std::memory_order_release);
-    failed_.store(true, std::memory_order_release);
-    isDone_.store(true, std::memory_order_release);
-    isDone_.notify_all();
+    Complete(STARTED | FAILED);
 }
 
 void Job::MarkStarted()
 {
-    hasStarted_.store(true, std::memory_order_release);
+    state_.fetch_or(STARTED, std::memory_order_release);
 }
 
-void Job::MarkDone()
+void Job::MarkDone(bool hasFailed)
 {
-    isDone_.store(true, std::memory_order_release);
-    isDone_.notify_all();
+    Complete(hasFailed ? FAILED : PENDING);
 }
 
 void Job::MarkFailed()
 {
-    failed_.store(true, std::memory_order_release);
+    state_.fetch_or(FAILED, std::memory_order_release);
 }
 
-void Job::Join() const
+void Job::Complete(std::uint32_t flags)
 {
+    // Close the list before publishing DONE: a joining thread may destroy this job right after,
+    // while the links themselves live in the dependent jobs.
+    auto* continuations = continuations_.exchange(&closedContinuations_, std::memory_order_acq_rel);
+    auto* counter = counter_;
+    auto* scheduler = scheduler_;
+    const auto previousState = state_.fetch_or(flags | STARTED | DONE, std::memory_order_acq_rel);
+    if ((previousState & WAITING) != 0)
+    {
+        state_.notify_all();
+        // The waiting thread may be the main thread, parked while it helps (see Join)
+        (scheduler != nullptr ? scheduler : &JobSystem::GetScheduler())->NotifyWaiters();
+    }
+    ReleaseContinuations(continuations);
+    if (counter != nullptr)
+    {
+        counter->Decrement();
+    }
+}
 
-#ifdef TRACY_ENABLE
-    ZoneScoped;
-#endif
-    while(!IsDone())
+JobCounter::JobCounter(int count)
+{
+    count_.store(count, std::memory_order_relaxed);
+    if (count == 0)
+    {
+        MarkStarted();
+        MarkDone();
+    }
+}
+
+void JobCounter::Add(int count)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+    if (count_.load(std::memory_order_acquire) == 0)
     {
-        isDone_.wait(false, std::memory_order_acquire);
+        Reset();
+        MarkStarted();
     }
+    count_.fetch_add(count, std::memory_order_acq_rel);
 }
 
+void JobCounter::Decrement()
+{
+    if (count_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        MarkDone();
+    }
+}
 
-bool DependentJob::ShouldStart() const
+bool Job::AddContinuation(DependencyLink* link)
+{
+    auto* head = continuations_.load(std::memory_order_acquire);
+    do
+    {
+        if (head == &closedContinuations_)
+        {
+            return false;
+        }
+        link->next = head;
+    } while (!continuations_.compare_exchange_weak(head, link,
+        std::memory_order_release, std::memory_order_acquire));
+    return true;
+}
+
+bool Job::ArmDependencies(std::span<DependencyLink> links)
 {
-    if(dependency_ != nullptr)
+    pendingDependencies_.store(static_cast<int>(links.size()) + 1, std::memory_order_relaxed);
+    // Dependencies already done (or absent) are released in one go, together with the guard count
+    // that kept the job from being dispatched while its links were being registered.
+    int released = 1;
+    for (auto& link : links)
     {
-        return dependency_->IsDone();
+        link.dependent = this;
+        if (link.dependency == nullptr || !link.dependency->AddContinuation(&link))
+        {
+            released++;
+        }
     }
-    return false;
+    return pendingDependencies_.fetch_sub(released, std::memory_order_acq_rel) == released;
 }
 
-bool DependentJob::CheckDependency(const Job *ptr) const
+bool Job::ReleaseDependency()
+{
+    return pendingDependencies_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+}
+
+void Job::Join() const
 {
+
 #ifdef TRACY_ENABLE
     ZoneScoped;
 #endif
-    if(ptr == this)
+    NEKO_PROFILE_ZONE("Job::Join");
+    if (IsDone())
     {
-        return true;
+        return;
+    }
+    // Set before helping, so that finishing wakes the main thread up if it parks in HelpWhileWaiting
+    auto state = state_.fetch_or(WAITING, std::memory_order_acq_rel);
+    if ((state & DONE) != 0)
+    {
+        return;
+    }
+    // Jobs never added, like a bare JobCounter, help the default scheduler
+    GetSchedulerOrDefault().HelpWhileWaiting([](const void* job) { return static_cast<const Job*>(job)->IsDone(); }, this);
+    state = state_.load(std::memory_order_acquire);
+    while ((state & DONE) == 0)
+    {
+        state_.wait(state, std::memory_order_acquire);
+        state = state_.load(std::memory_order_acquire);
     }
-    auto dep = dependency_;
-    if(dep != nullptr) {
-        return dep->CheckDependency(ptr);
+}
+
+
+bool DependentJob::ShouldStart() const
+{
+    if(dependency_.dependency != nullptr)
+    {
+        return dependency_.dependency->IsDone();
     }
     return false;
 }
@@ -162,10 +301,10 @@ void DependentJob::Execute()
 #ifdef TRACY_ENABLE
     ZoneScoped;
 #endif
-    if(dependency_ != nullptr)
+    if(dependency_.dependency != nullptr)
     {
-		dependency_->Join();
-        if (dependency_->HasFailed())
+		dependency_.dependency->Join();
+        if (dependency_.dependency->HasFailed())
         {
             SkipAsFailed();
             return;
@@ -174,15 +313,24 @@ void DependentJob::Execute()
     Job::Execute();
 }
 
+DependenciesJob::DependenciesJob(std::initializer_list<Job*> dependencies)
+{
+    dependencies_.reserve(dependencies.size());
+    for (auto* dependency : dependencies)
+    {
+        dependencies_.push_back({dependency, this});
+    }
+}
+
 bool DependenciesJob::ShouldStart() const
 {
 #ifdef TRACY_ENABLE
     ZoneScoped;
 #endif
     bool shouldStart = true;
-    for (auto& dependency : dependencies_)
+    for (auto& link : dependencies_)
     {
-        if (dependency != nullptr && !dependency->IsDone())
+        if (link.dependency != nullptr && !link.dependency->IsDone())
         {
             shouldStart = false;
             break;
@@ -191,39 +339,28 @@ bool DependenciesJob::ShouldStart() const
     return shouldStart;
 }
 
-bool DependenciesJob::AddDependency(Job* dependency)
+bool DependenciesJob::AddDependency(Job* dependency, DependencyCheck check)
 {
-    if(dependency == nullptr || dependency->CheckDependency(this))
+    if(dependency == nullptr || (check == DependencyCheck::Validate && dependency->CheckDependency(this)))
     {
         return false;
     }
-    dependencies_.push_back(dependency);
+    dependencies_.push_back({dependency, this});
     return true;
 }
 
-bool DependenciesJob::CheckDependency(const Job *ptr) const
-{
-    if(ptr == this)
-    {
-        return true;
-    }
-	return std::ranges::any_of(dependencies_, [ptr](const auto* dep){
-		return dep->CheckDependency(ptr);
-	});
-}
-
 void DependenciesJob::Execute()
 {
 
 #ifdef TRACY_ENABLE
     ZoneScoped;
 #endif
-    for(auto& dependency : dependencies_)
+    for(auto& link : dependencies_)
     {
-        if(dependency != nullptr)
+        if(link.dependency != nullptr)
         {
-			dependency->Join();
-            if (dependency->HasFailed())
+			link.dependency->Join();
+            if (link.dependency->HasFailed())
             {
                 SkipAsFailed();
                 return;
@@ -236,19 +373,7 @@ void DependenciesJob::Execute()
 
 bool ScheduleJob::ShouldStart() const
 {
-    return dependency_ == nullptr || dependency_->HasStarted();
-}
-
-bool ScheduleJob::CheckDependency(const Job* ptr) const
-{
-#ifdef TRACY_ENABLE
-    ZoneScoped;
-#endif
-    if (ptr == this)
-    {
-        return true;
-    }
-    return dependency_ != nullptr && dependency_->CheckDependency(ptr);
+    return dependency_.dependency == nullptr || dependency_.dependency->HasStarted();
 }
 
 void ScheduleJob::Execute()
@@ -259,9 +384,10 @@ void ScheduleJob::Execute()
 #endif
     MarkStarted();
 
-    if (dependency_ != nullptr)
+    auto* dependency = dependency_.dependency;
+    if (dependency != nullptr)
     {
-        dependency_->Join();
+        dependency->Join();
     }
 
     // Always schedule the contained job, even on upstream failure / cancellation,
@@ -269,16 +395,268 @@ void ScheduleJob::Execute()
     // own cancel flag handles cancellation end-to-end.
     if (containedJob_ != nullptr)
     {
-        JobSystem::AddJob(containedJob_, queueIndex_);
+        GetSchedulerOrDefault().AddJob(containedJob_, queueIndex_);
+    }
+
+    MarkDone(IsCancelled() || (dependency != nullptr && dependency->HasFailed()));
+}
+
+
+/**
+ * \brief JobPool hands out FunctionJob slots to one owner thread at a time, without locking: the owner
+ * pops from its private free list, and slots released by other threads are pushed on a lock-free
+ * stack that the owner takes over whole when its list runs dry (so there is no ABA).
+ * Pools are never destroyed before exit, since released slots still point to them: when its thread
+ * exits, a pool is parked and adopted by the next thread needing one.
+ */
+class JobPool
+{
+public:
+    FunctionJob* Acquire();
+    void Release(FunctionJob* job);
+    [[nodiscard]] std::size_t GetSlotCount() const { return blocks_.size() * blockSize; }
+
+    static JobPool& GetThreadPool();
+private:
+    static constexpr std::size_t blockSize = 64;
+
+    class ThreadPoolHolder
+    {
+    public:
+        ~ThreadPoolHolder();
+        JobPool* pool = nullptr;
+    };
+    static std::mutex poolsMutex_;
+    static std::vector<std::unique_ptr<JobPool>> pools_;
+    static std::vector<JobPool*> parkedPools_;
+    static thread_local ThreadPoolHolder threadPool_;
+
+    FunctionJob* localFree_ = nullptr;
+    std::atomic<FunctionJob*> remoteFree_{nullptr};
+    std::vector<std::unique_ptr<FunctionJob[]>> blocks_;
+};
+
+std::mutex JobPool::poolsMutex_;
+std::vector<std::unique_ptr<JobPool>> JobPool::pools_;
+std::vector<JobPool*> JobPool::parkedPools_;
+thread_local JobPool::ThreadPoolHolder JobPool::threadPool_;
+
+JobPool::ThreadPoolHolder::~ThreadPoolHolder()
+{
+    if (pool != nullptr)
+    {
+        std::scoped_lock lock(poolsMutex_);
+        parkedPools_.push_back(pool);
+    }
+}
+
+JobPool& JobPool::GetThreadPool()
+{
+    if (threadPool_.pool == nullptr)
+    {
+        std::scoped_lock lock(poolsMutex_);
+        if (parkedPools_.empty())
+        {
+            pools_.push_back(std::make_unique<JobPool>());
+            threadPool_.pool = pools_.back().get();
+        }
+        else
+        {
+            threadPool_.pool = parkedPools_.back();
+            parkedPools_.pop_back();
+        }
+    }
+    return *threadPool_.pool;
+}
+
+FunctionJob* JobPool::Acquire()
+{
+    if (localFree_ == nullptr)
+    {
+        localFree_ = remoteFree_.exchange(nullptr, std::memory_order_acquire);
+    }
+    if (localFree_ == nullptr)
+    {
+        blocks_.push_back(std::make_unique<FunctionJob[]>(blockSize));
+        auto& block = blocks_.back();
+        for (std::size_t i = 0; i < blockSize; i++)
+        {
+            block[i].pool_ = this;
+            block[i].nextFree_ = i + 1 < blockSize ? &block[i + 1] : nullptr;
+        }
+        localFree_ = &block[0];
+    }
+    auto* job = localFree_;
+    localFree_ = job->nextFree_;
+    job->references_.store(1, std::memory_order_relaxed);
+    return job;
+}
+
+void JobPool::Release(FunctionJob* job)
+{
+    if (threadPool_.pool == this)
+    {
+        job->nextFree_ = localFree_;
+        localFree_ = job;
+        return;
+    }
+    auto* head = remoteFree_.load(std::memory_order_relaxed);
+    do
+    {
+        job->nextFree_ = head;
+    } while (!remoteFree_.compare_exchange_weak(head, job,
+        std::memory_order_release, std::memory_order_relaxed));
+}
+
+void FunctionJob::Execute()
+{
+    Job::Execute();
+    // The pending execution reference, the slot may go back to its pool right here
+    RemoveReference();
+}
+
+void FunctionJob::RemoveReference()
+{
+    if (references_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        destroy_(storage_);
+        // The next user of the slot starts from a clean job
+        SetCancelFlag(nullptr);
+        SetCounter(nullptr);
+        pool_->Release(this);
+    }
+}
+
+/**
+ * \brief ThreadCounters are the telemetry counters of one thread. Only that thread writes them, with
+ * relaxed load and store pairs instead of read-modify-writes, and they sit on their own cache lines,
+ * so that GetStats can read them at any time without slowing the thread down.
+ */
+class alignas(64) ThreadCounters
+{
+public:
+    static std::int64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static void MarkReady(Job* job, std::int64_t now) { job->readyTime_ = now; }
+    static std::int64_t GetReadyTime(const Job& job) { return job.readyTime_; }
+
+    void AddExecution(std::int64_t readyTime, std::int64_t start, std::int64_t end)
+    {
+        Increment(executedJobs_, 1);
+        Increment(busyTime_, static_cast<std::uint64_t>(end - start));
+        const auto latency = static_cast<std::uint64_t>(std::max<std::int64_t>(start - readyTime, 0));
+        Increment(startLatency_[LatencyHistogram::GetBucket(latency)], 1);
+    }
+    void AddRequeue() { Increment(requeuedJobs_, 1); }
+    void AddIdle(std::int64_t duration) { Increment(idleTime_, static_cast<std::uint64_t>(duration)); }
+
+    [[nodiscard]] ThreadStats GetStats() const
+    {
+        ThreadStats stats{};
+        stats.executedJobs = executedJobs_.load(std::memory_order_relaxed);
+        stats.requeuedJobs = requeuedJobs_.load(std::memory_order_relaxed);
+        stats.busyTime = std::chrono::nanoseconds(busyTime_.load(std::memory_order_relaxed));
+        stats.idleTime = std::chrono::nanoseconds(idleTime_.load(std::memory_order_relaxed));
+        for (std::size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; i++)
+        {
+            stats.startLatency.buckets[i] = startLatency_[i].load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+private:
+    static void Increment(std::atomic<std::uint64_t>& counter, std::uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
     }
 
-    if (IsCancelled() || (dependency_ != nullptr && dependency_->HasFailed()))
+    std::atomic<std::uint64_t> executedJobs_{0};
+    std::atomic<std::uint64_t> requeuedJobs_{0};
+    std::atomic<std::uint64_t> busyTime_{0};
+    std::atomic<std::uint64_t> idleTime_{0};
+    std::array<std::atomic<std::uint64_t>, LatencyHistogram::BUCKET_COUNT> startLatency_{};
+};
+
+std::uint64_t LatencyHistogram::GetCount() const
+{
+    std::uint64_t count = 0;
+    for (const auto bucket : buckets)
+    {
+        count += bucket;
+    }
+    return count;
+}
+
+LatencyHistogram& LatencyHistogram::operator+=(const LatencyHistogram& other)
+{
+    for (std::size_t i = 0; i < BUCKET_COUNT; i++)
+    {
+        buckets[i] += other.buckets[i];
+    }
+    return *this;
+}
+
+namespace
+{
+// Counters of the calling thread, set by Worker::Run and ExecuteMainThread, null on other threads
+thread_local ThreadCounters* currentCounters_ = nullptr;
+
+void CountRequeue()
+{
+    if (currentCounters_ != nullptr)
     {
-        MarkFailed();
+        currentCounters_->AddRequeue();
     }
-    MarkDone();
 }
 
+/**
+ * \brief ExecuteJob runs a job popped from a queue, in a profiler zone telling which lane it came from,
+ * and records its execution time in durationHistory when it has a duration key
+ */
+void ExecuteJob(Job* job, DurationHistory& durationHistory)
+{
+#ifdef TRACY_ENABLE
+    ZoneScopedN("ExecuteJob");
+    static constexpr std::array<std::string_view, JOB_PRIORITY_COUNT> laneNames{"High", "Normal", "Low"};
+    const auto laneName = laneNames[static_cast<std::size_t>(job->GetPriority())];
+    ZoneText(laneName.data(), laneName.size());
+#endif
+    NEKO_PROFILE_ZONE("ExecuteJob");
+    auto* counters = currentCounters_;
+    // The job may be recycled as soon as it is done, read it before
+    const auto durationKey = job->GetDurationKey();
+    if (counters == nullptr && durationKey == NO_DURATION_KEY)
+    {
+        job->Execute();
+        return;
+    }
+    const auto readyTime = ThreadCounters::GetReadyTime(*job);
+    const auto start = ThreadCounters::Now();
+    job->Execute();
+    const auto end = ThreadCounters::Now();
+    if (counters != nullptr)
+    {
+        counters->AddExecution(readyTime, start, end);
+    }
+    if (durationKey != NO_DURATION_KEY)
+    {
+        durationHistory.Record(durationKey, std::chrono::nanoseconds(end - start));
+    }
+}
+
+void CpuPause()
+{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+}
+
+class Worker;
 
 class WorkerQueue
 {
@@ -286,41 +664,159 @@ public:
     WorkerQueue() = default;
     WorkerQueue(const WorkerQueue&) = delete;
     WorkerQueue& operator= (const WorkerQueue&) = delete;
-    WorkerQueue(WorkerQueue&&) noexcept{}
-    WorkerQueue& operator= (WorkerQueue&&) noexcept{ return *this; }
+    // Queues only move while being set up, empty, so only the settings are carried over
+    WorkerQueue(WorkerQueue&& other) noexcept : agingInterval_(other.agingInterval_), idlePolicy_(other.idlePolicy_) {}
+    WorkerQueue& operator= (WorkerQueue&& other) noexcept
+    {
+        agingInterval_ = other.agingInterval_;
+        idlePolicy_ = other.idlePolicy_;
+        return *this;
+    }
 
     void AddJob(Job* newJob);
+    void AddJobs(std::span<Job* const> newJobs, JobPriority priority);
     bool IsEmpty() const;
+    [[nodiscard]] bool HasHighPriorityJobs() const;
     Job* PopNextTask();
-    bool WaitDequeue(Job*& out, std::int64_t timeoutUsecs);
+    /**
+     * \brief PopNextTasks dequeues up to out.size() jobs at once, in priority lane order
+     * @return the number of jobs written to out
+     */
+    std::size_t PopNextTasks(std::span<Job*> out);
+    [[nodiscard]] std::size_t SizeApprox() const;
+    /**
+     * \brief WaitJob follows the idle policy until findJob returns a job or shouldStop is true, in which
+     * case it returns null. It can also return null on a wake-up, callers simply loop.
+     */
+    template<typename FindJobFunc, typename ShouldStopFunc>
+    Job* WaitJob(FindJobFunc findJob, ShouldStopFunc shouldStop);
+    /**
+     * \brief Park is the last phase of WaitJob alone: it sleeps until the next Wake, unless findJob
+     * returns a job or shouldStop is true once registered as a sleeper
+     */
+    template<typename FindJobFunc, typename ShouldStopFunc>
+    Job* Park(FindJobFunc findJob, ShouldStopFunc shouldStop);
+    /**
+     * \brief Wake unparks up to count threads, only when some are parked
+     */
+    void Wake(std::size_t count = 1);
     void End();
+
+    void AddWorker(Worker* worker) { workers_.push_back(worker); }
+    [[nodiscard]] const std::vector<Worker*>& GetWorkers() const { return workers_; }
+    void SetAgingInterval(std::uint32_t interval) { agingInterval_ = interval; }
+    void SetIdlePolicy(const IdlePolicy& policy) { idlePolicy_ = policy; }
+    [[nodiscard]] const IdlePolicy& GetIdlePolicy() const { return idlePolicy_; }
 private:
-    moodycamel::BlockingConcurrentQueue<Job*> jobsQueue_;
+    /**
+     * \brief DequeueLane is called once the semaphore granted a job, so one of the lanes has it
+     */
+    Job* DequeueLane();
+    [[nodiscard]] bool IsAgedDequeue();
+
+    // One lane per JobPriority, and the count of jobs in all lanes for the waiting workers, the same
+    // way moodycamel::BlockingConcurrentQueue pairs a ConcurrentQueue with a LightweightSemaphore.
+    std::array<moodycamel::ConcurrentQueue<Job*>, JOB_PRIORITY_COUNT> lanes_;
+    moodycamel::LightweightSemaphore jobCount_;
+    std::atomic<std::uint32_t> dequeueCount_{0};
+    std::uint32_t agingInterval_ = 0;
+    IdlePolicy idlePolicy_{};
+    // Parked threads wait for wakeEpoch_ to change, producers only bump it when sleepers_ is not zero
+    alignas(64) std::atomic<std::uint32_t> wakeEpoch_{0};
+    std::atomic<std::uint32_t> sleepers_{0};
+    // Registered by Begin, they are also the steal victims on work-stealing queues
+    std::vector<Worker*> workers_;
 };
 
 
 
 
+class JobSchedulerState;
+
 class Worker
 {
 public:
-    Worker(std::size_t queueIndex, std::size_t workerIndex)
-        : queueIndex_(queueIndex), workerIndex_(workerIndex){}
+    Worker(JobSchedulerState& scheduler, std::size_t queueIndex, std::size_t workerIndex, QueueMode mode,
+        std::vector<int> cpus = {});
     void Begin();
     void End();
+    [[nodiscard]] std::size_t GetQueueIndex() const { return queueIndex_; }
+    [[nodiscard]] const JobSchedulerState* GetScheduler() const { return scheduler_; }
+    [[nodiscard]] ThreadStats GetStats() const;
+    /**
+     * \brief PushLocal is only valid from the worker's own thread, on a work-stealing queue
+     */
+    void PushLocal(Job* newJob) { deque_->Push(newJob); }
+    /**
+     * \brief PushLifo puts newJob in the LIFO slot, only valid from the worker's own thread, on a FIFO queue
+     * @return the job it replaced, null if the slot was empty
+     */
+    Job* PushLifo(Job* newJob) { return lifoSlot_->exchange(newJob, std::memory_order_acq_rel); }
+    [[nodiscard]] bool IsWorkStealing() const { return workStealing_; }
+    [[nodiscard]] bool HasLocalJobs() const
+    {
+        return !deque_->IsEmpty() || lifoSlot_->load(std::memory_order_relaxed) != nullptr;
+    }
+    Job* FindJob();
+    /**
+     * \brief StealJob takes a job from one of the other workers of the queue, starting from a random
+     * victim. thief can be null when the caller is not a worker.
+     */
+    static Job* StealJob(const std::vector<Worker*>& victims, Worker* thief, std::uint32_t& randomState);
 private:
-    void Run() const;
+    void Run();
+    /**
+     * \brief Drain executes the jobs left in the shared queue and the local deque, once paused or stopped
+     */
+    void Drain();
+    /**
+     * \brief PopBatch takes a batch of jobs from the shared queue, returns the first one and keeps the
+     * others on the local deque, where idle siblings can still steal them
+     */
+    Job* PopBatch();
+    static constexpr std::size_t maxBatchSize = 8;
+    /**
+     * \brief PopLifo takes the job of the LIFO slot. After maxLifoStreak slot jobs in a row, the next one
+     * goes to the shared queue instead, so that a job spawning a job every time cannot starve the queue.
+     */
+    Job* PopLifo();
+    static constexpr std::uint32_t maxLifoStreak = 16;
+
     std::thread thread_;
+    JobSchedulerState* scheduler_ = nullptr;
+    // Behind a pointer for the same reason as deque_, and read by GetStats from any thread
+    std::unique_ptr<ThreadCounters> counters_ = std::make_unique<ThreadCounters>();
+    // Jobs spawned by this worker on work-stealing queues, and the rest of the last batch taken from the
+    // shared queue. Behind a pointer so that Worker stays movable inside workers_.
+    std::unique_ptr<WorkStealingDeque<Job*>> deque_ = std::make_unique<WorkStealingDeque<Job*>>(64);
+    // On FIFO queues, the job this worker dispatched last, run next on this worker unless an idle
+    // sibling steals it first. Behind a pointer like deque_.
+    std::unique_ptr<std::atomic<Job*>> lifoSlot_ = std::make_unique<std::atomic<Job*>>(nullptr);
+    std::uint32_t lifoStreak_ = 0;
+    bool workStealing_ = false;
+    std::uint32_t randomState_ = 0;
+    // Logical cpus the thread is pinned to when it starts, empty to let the OS place it
+    std::vector<int> cpus_;
     std::size_t queueIndex_ = std::numeric_limits<size_t>::max();
-    // Only used to build this worker's profiler thread name, so it need not be globally unique --
+    // Used for this worker's profiler thread name and its stats, so it need not be globally unique --
     // it is an ordinal within the queue.
-    //
-    // ⚠️ [[maybe_unused]] is load-bearing, not decoration: this field is read ONLY inside an
-    // #ifdef TRACY_ENABLE block, and NekoCore compiles with -Werror on every non-MSVC toolchain, so
-    // without it a plain (non-profiling) clang build fails on -Wunused-private-field.
-    [[maybe_unused]] std::size_t workerIndex_ = 0;
+    std::size_t workerIndex_ = 0;
 };
 
+namespace
+{
+// Set for the lifetime of Worker::Run, so that JobScheduler::AddJob can find the calling worker.
+thread_local Worker* currentWorker_ = nullptr;
+}
+
+Worker::Worker(JobSchedulerState& scheduler, std::size_t queueIndex, std::size_t workerIndex, QueueMode mode,
+    std::vector<int> cpus) : scheduler_(&scheduler), workStealing_(mode == QueueMode::WorkStealing), cpus_(std::move(cpus)), queueIndex_(queueIndex),
+    workerIndex_(workerIndex)
+{
+    // Any odd, distinct seed will do for the xorshift victim selection.
+    randomState_ = static_cast<std::uint32_t>(queueIndex * 7919u + workerIndex * 2u + 1u);
+}
+
 void Worker::Begin()
 {
     thread_ = std::thread(&Worker::Run, this);
@@ -336,85 +832,1267 @@ void Worker::End()
 
 
 
-namespace JobSystem
-{
 namespace
 {
-WorkerQueue mainThreadQueue_{};
-std::vector<WorkerQueue> queues_{};
-std::vector<Worker> workers_{};
-std::atomic<bool> isRunning_{ false };
+// Nested HelpWhileWaiting calls of this thread, whatever the scheduler
+thread_local int helpDepth_ = 0;
 }
 
-int SetupNewQueue(int threadCount)
+/**
+ * \brief JobSchedulerState holds the queues and the workers of a JobScheduler, kept out of the header
+ */
+class JobSchedulerState
 {
-    const int newQueueIndex = static_cast<int>(queues_.size());
-    queues_.emplace_back();
-    for(int i = 0; i < threadCount; i++)
+public:
+    explicit JobSchedulerState(JobScheduler& owner) : owner_(owner) {}
+    ~JobSchedulerState();
+
+    int SetupNewQueue(int threadCount, QueueMode mode, std::vector<std::vector<int>> cpuSets);
+    void SetPriorityAging(int queueIndex, std::uint32_t interval);
+    void SetIdlePolicy(int queueIndex, const IdlePolicy& policy);
+    void Begin();
+    void Pause();
+    void Resume();
+    void End();
+    [[nodiscard]] bool IsRunning() const { return runState_.load(std::memory_order_acquire) != RunState::Stopped; }
+    [[nodiscard]] bool IsPaused() const { return runState_.load(std::memory_order_acquire) == RunState::Paused; }
+    /**
+     * \brief IsActive is false once paused or stopped, the workers then drain their queue
+     */
+    [[nodiscard]] bool IsActive() const { return runState_.load(std::memory_order_acquire) == RunState::Running; }
+
+    /**
+     * \brief AddJob with isReserved set adds a main queue job already counted by ReserveMainThreadJobs
+     */
+    void AddJob(Job* newJob, int queueIndex, JobPriority priority, bool isReserved = false);
+    void AddJobs(std::span<Job* const> newJobs, int queueIndex, JobPriority priority);
+    void AddJobs(std::span<Job* const> newJobs, JobCounter& counter, int queueIndex, JobPriority priority);
+    void Dispatch(Job* readyJob, int queueIndex);
+    void DispatchBulk(std::span<Job* const> readyJobs, int queueIndex, JobPriority priority);
+    void ExecuteMainThread();
+    std::size_t ExecuteMainThread(const MainThreadBudget& budget);
+    void HelpWhileWaiting(JobScheduler::WaitPredicate isDone, const void* userData);
+    void ParallelForRange(std::size_t begin, std::size_t end, JobScheduler::RangeFunction func, void* userData,
+        int queueIndex, std::size_t grainSize);
+    [[nodiscard]] JobSystemStats GetStats() const;
+    TimerId AddTimer(Job* job, TimerWheel::Clock::duration delay, TimerWheel::Clock::duration period, int queueIndex,
+        JobPriority priority);
+    bool CancelTimer(TimerId timerId);
+    DurationHistory& GetDurationHistory() { return durationHistory_; }
+
+    void AddMainThreadPending(int count) { mainThreadPendingJobs_.fetch_add(count, std::memory_order_relaxed); }
+    WorkerQueue& GetQueue(std::size_t queueIndex) { return queues_[queueIndex]; }
+    /**
+     * \brief GetWaitQueue is the queue a thread helping with queueIndex parks on, the main thread queue
+     * included
+     */
+    WorkerQueue& GetWaitQueue(int queueIndex)
     {
-        workers_.emplace_back(static_cast<std::size_t>(newQueueIndex), static_cast<std::size_t>(i));
+        return queueIndex == MAIN_QUEUE_INDEX ? mainThreadQueue_ : queues_[static_cast<std::size_t>(queueIndex)];
     }
-    return newQueueIndex;
-}
+    void NotifyWaiters() { mainThreadQueue_.Wake(); }
+    /**
+     * \brief PopReadyJob returns a job from queueIndex for a thread helping while it waits, using the
+     * worker own deque when the caller is one of the queue workers
+     */
+    Job* PopReadyJob(int queueIndex);
+    /**
+     * \brief ExecuteHelpedJob runs a job popped by PopReadyJob, or puts it back when it should not start yet
+     */
+    void ExecuteHelpedJob(Job* job, int queueIndex);
+    /**
+     * \brief SplitHint tells the lazy splitting whether other workers could take more work right now
+     */
+    [[nodiscard]] bool SplitHint(int queueIndex) const;
 
-void Begin()
-{
-    isRunning_.store(true, std::memory_order_release);
-    for(auto& worker : workers_)
+    /**
+     * \brief GetPauseGeneration is read by a worker before it drains its queue, see WaitWhilePaused
+     */
+    std::uint64_t GetPauseGeneration();
+    /**
+     * \brief WaitWhilePaused reports a drained worker to Pause and parks it until Resume or End. A pause
+     * started after pauseGeneration was read does not count the worker, which must drain again.
+     * @return false once stopped, the worker then exits
+     */
+    bool WaitWhilePaused(std::uint64_t pauseGeneration);
+private:
+    /**
+     * \brief RunTimers is the timer thread, parked until the next deadline of the wheel or a new earlier timer
+     */
+    void RunTimers();
+    void DispatchTimers(std::span<ExpiredTimer> expired);
+    void StopTimers();
+
+    [[nodiscard]] bool IsCurrentWorker(int queueIndex) const
     {
-        worker.Begin();
+        return currentWorker_ != nullptr && currentWorker_->GetScheduler() == this &&
+            currentWorker_->GetQueueIndex() == static_cast<std::size_t>(queueIndex);
     }
+
+    enum class RunState : std::uint8_t
+    {
+        Stopped,
+        Running,
+        Paused
+    };
+
+    JobScheduler& owner_;
+    WorkerQueue mainThreadQueue_{};
+    std::vector<WorkerQueue> queues_{};
+    std::vector<Worker> workers_{};
+    std::atomic<RunState> runState_{RunState::Stopped};
+    // Main thread jobs added but not executed yet, whether they are already dispatched or still waiting
+    // on their dependencies. ExecuteMainThread drains until it reaches zero.
+    std::atomic<int> mainThreadPendingJobs_{ 0 };
+    // The thread that called Begin, the one helping with the main thread queue while it waits
+    std::thread::id mainThreadId_{};
+    ThreadCounters mainThreadCounters_{};
+    // Not ready jobs held by the budgeted ExecuteMainThread, only touched by the main thread
+    std::vector<Job*> heldMainThreadJobs_;
+    // Pause waits for every worker to drain its queue, the workers then wait for Resume or End
+    std::mutex pauseMutex_;
+    std::condition_variable pauseCondition_;
+    std::uint64_t pauseGeneration_ = 0;
+    std::size_t drainedWorkers_ = 0;
+    // Guards the wheel, the timer thread waits on timerCondition_ until timerWakeTime_
+    std::mutex timerMutex_;
+    std::condition_variable timerCondition_;
+    TimerWheel timerWheel_{};
+    TimerWheel::Clock::time_point timerWakeTime_ = TimerWheel::Clock::time_point::max();
+    std::thread timerThread_;
+    bool stopTimers_ = false;
+    DurationHistory durationHistory_{};
+};
+
+JobSchedulerState::~JobSchedulerState()
+{
+    StopTimers();
 }
 
-void AddJob(Job* newJob, int queueIndex)
+void JobSchedulerState::Dispatch(Job* readyJob, int queueIndex)
 {
-#ifdef TRACY_ENABLE
-    ZoneScoped;
-#endif
-    newJob->Reset();
+    ThreadCounters::MarkReady(readyJob, ThreadCounters::Now());
     if(queueIndex == MAIN_QUEUE_INDEX)
     {
-        mainThreadQueue_.AddJob(newJob);
+        mainThreadQueue_.AddJob(readyJob);
         return;
     }
-    queues_[queueIndex].AddJob(newJob);
-}
-
-void End()
-{
-
-    isRunning_.store(false, std::memory_order_release);
-    for(auto& queue: queues_)
+    if (IsCurrentWorker(queueIndex) && currentWorker_->IsWorkStealing() &&
+        readyJob->GetPriority() != JobPriority::High)
     {
-        queue.End();
+        currentWorker_->PushLocal(readyJob);
+        // Parked siblings can steal it
+        queues_[queueIndex].Wake();
+        return;
     }
-    for(auto& worker: workers_)
+    if (IsCurrentWorker(queueIndex) && readyJob->GetPriority() == JobPriority::Normal)
     {
-        worker.End();
+        // A job dispatched from a worker of a FIFO queue (spawned, or released by the job it depends on)
+        // runs next on the same worker while its data is still in cache. Only the last one stays local,
+        // the one it replaces goes to the shared queue. Low jobs still wait behind the Normal lane.
+        if (auto* replacedJob = currentWorker_->PushLifo(readyJob); replacedJob != nullptr)
+        {
+            queues_[queueIndex].AddJob(replacedJob);
+        }
+        else
+        {
+            queues_[queueIndex].Wake();
+        }
+        return;
     }
-    queues_.clear();
-    workers_.clear();
+    queues_[queueIndex].AddJob(readyJob);
+}
+
+void JobSchedulerState::DispatchBulk(std::span<Job* const> readyJobs, int queueIndex, JobPriority priority)
+{
+    const auto now = ThreadCounters::Now();
+    for (auto* readyJob : readyJobs)
+    {
+        ThreadCounters::MarkReady(readyJob, now);
+    }
+    if(queueIndex == MAIN_QUEUE_INDEX)
+    {
+        mainThreadQueue_.AddJobs(readyJobs, priority);
+        return;
+    }
+    if (IsCurrentWorker(queueIndex) && currentWorker_->IsWorkStealing() && priority != JobPriority::High)
+    {
+        // Pop is LIFO, push backwards so that the owner still runs the batch in order
+        for (auto* readyJob : readyJobs | std::views::reverse)
+        {
+            currentWorker_->PushLocal(readyJob);
+        }
+        queues_[queueIndex].Wake(readyJobs.size());
+        return;
+    }
+    queues_[queueIndex].AddJobs(readyJobs, priority);
+}
+
+int JobSchedulerState::SetupNewQueue(int threadCount, QueueMode mode, std::vector<std::vector<int>> cpuSets)
+{
+    const int newQueueIndex = static_cast<int>(queues_.size());
+    queues_.emplace_back();
+    for(int i = 0; i < threadCount; i++)
+    {
+        const auto workerIndex = static_cast<std::size_t>(i);
+        workers_.emplace_back(*this, static_cast<std::size_t>(newQueueIndex), workerIndex, mode,
+            workerIndex < cpuSets.size() ? std::move(cpuSets[workerIndex]) : std::vector<int>{});
+    }
+    return newQueueIndex;
+}
+
+void JobSchedulerState::SetPriorityAging(int queueIndex, std::uint32_t interval)
+{
+    if (queueIndex == MAIN_QUEUE_INDEX)
+    {
+        mainThreadQueue_.SetAgingInterval(interval);
+        return;
+    }
+    queues_[queueIndex].SetAgingInterval(interval);
+}
+
+void JobSchedulerState::SetIdlePolicy(int queueIndex, const IdlePolicy& policy)
+{
+    if (queueIndex == MAIN_QUEUE_INDEX)
+    {
+        mainThreadQueue_.SetIdlePolicy(policy);
+        return;
+    }
+    queues_[queueIndex].SetIdlePolicy(policy);
+}
+
+void JobSchedulerState::Begin()
+{
+    mainThreadId_ = std::this_thread::get_id();
+    runState_.store(RunState::Running, std::memory_order_release);
+    // workers_ does not move anymore, so the workers (and steal victims) can be registered by address
+    for(auto& worker : workers_)
+    {
+        queues_[worker.GetQueueIndex()].AddWorker(&worker);
+    }
+    for(auto& worker : workers_)
+    {
+        worker.Begin();
+    }
+}
+
+void JobSchedulerState::Pause()
+{
+#ifdef TRACY_ENABLE
+    ZoneScoped;
+#endif
+    // It would wait for its own thread to drain
+    if (currentWorker_ != nullptr && currentWorker_->GetScheduler() == this)
+    {
+        throw std::logic_error("JobScheduler paused from one of its own workers");
+    }
+    std::unique_lock lock(pauseMutex_);
+    if (runState_.load(std::memory_order_relaxed) != RunState::Running)
+    {
+        return;
+    }
+    runState_.store(RunState::Paused, std::memory_order_release);
+    pauseGeneration_++;
+    drainedWorkers_ = 0;
+    for (auto& queue : queues_)
+    {
+        queue.End();
+    }
+    pauseCondition_.wait(lock, [this] { return drainedWorkers_ == workers_.size(); });
+}
+
+void JobSchedulerState::Resume()
+{
+    {
+        std::scoped_lock lock(pauseMutex_);
+        if (runState_.load(std::memory_order_relaxed) != RunState::Paused)
+        {
+            return;
+        }
+        runState_.store(RunState::Running, std::memory_order_release);
+    }
+    pauseCondition_.notify_all();
+}
+
+void JobSchedulerState::End()
+{
+    StopTimers();
+    {
+        std::scoped_lock lock(pauseMutex_);
+        runState_.store(RunState::Stopped, std::memory_order_release);
+    }
+    pauseCondition_.notify_all();
+    for(auto& queue: queues_)
+    {
+        queue.End();
+    }
+    for(auto& worker: workers_)
+    {
+        worker.End();
+    }
+    queues_.clear();
+    workers_.clear();
+    // The main thread queue outlives End, its settings go back to the defaults like those of the cleared queues
+    mainThreadQueue_.SetIdlePolicy({});
+    mainThreadQueue_.SetAgingInterval(0);
+    // Only the main thread jobs already queued still run, the reservations of those that never will
+    // (a dependency never added, a JobGraph run cut short...) would keep ExecuteMainThread waiting
+    mainThreadPendingJobs_.store(static_cast<int>(mainThreadQueue_.SizeApprox()), std::memory_order_release);
+}
+
+std::uint64_t JobSchedulerState::GetPauseGeneration()
+{
+    std::scoped_lock lock(pauseMutex_);
+    return pauseGeneration_;
+}
+
+bool JobSchedulerState::WaitWhilePaused(std::uint64_t pauseGeneration)
+{
+    std::unique_lock lock(pauseMutex_);
+    const auto runState = runState_.load(std::memory_order_relaxed);
+    if (runState == RunState::Stopped)
+    {
+        return false;
+    }
+    if (runState == RunState::Paused && pauseGeneration == pauseGeneration_)
+    {
+        drainedWorkers_++;
+        pauseCondition_.notify_all();
+        pauseCondition_.wait(lock, [this, pauseGeneration]
+        {
+            return runState_.load(std::memory_order_relaxed) != RunState::Paused || pauseGeneration != pauseGeneration_;
+        });
+    }
+    // Jobs added while paused are still to be drained when woken up by End
+    return true;
+}
+
+void JobSchedulerState::AddJob(Job* newJob, int queueIndex, JobPriority priority, bool isReserved)
+{
+#ifdef TRACY_ENABLE
+    ZoneScoped;
+#endif
+    NEKO_PROFILE_ZONE("JobScheduler::AddJob");
+    newJob->Reset();
+    newJob->scheduler_ = &owner_;
+    newJob->queueIndex_ = queueIndex;
+    newJob->priority_ = priority;
+    if (queueIndex == MAIN_QUEUE_INDEX && !isReserved)
+    {
+        mainThreadPendingJobs_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (newJob->ArmDependencies(newJob->GetDependencyLinks()))
+    {
+        Dispatch(newJob, queueIndex);
+    }
+}
+
+void JobSchedulerState::AddJobs(std::span<Job* const> newJobs, int queueIndex, JobPriority priority)
+{
+#ifdef TRACY_ENABLE
+    ZoneScoped;
+#endif
+    NEKO_PROFILE_ZONE("JobScheduler::AddJobs");
+    if (queueIndex == MAIN_QUEUE_INDEX)
+    {
+        mainThreadPendingJobs_.fetch_add(static_cast<int>(newJobs.size()), std::memory_order_relaxed);
+    }
+    // With duration keys in the batch, the ready jobs start longest expected first, so that a long job
+    // does not start last and stretch the batch. Jobs without history count as zero and keep their order.
+    const bool isLongestFirst = std::ranges::any_of(newJobs, [](const Job* newJob)
+    {
+        return newJob->GetDurationKey() != NO_DURATION_KEY;
+    });
+    thread_local std::vector<Job*> sortedJobs;
+    constexpr std::size_t batchSize = 64;
+    std::array<Job*, batchSize> readyJobs{};
+    std::size_t readyCount = 0;
+    for (auto* newJob : newJobs)
+    {
+        newJob->Reset();
+        newJob->scheduler_ = &owner_;
+        newJob->queueIndex_ = queueIndex;
+        newJob->priority_ = priority;
+        if (newJob->ArmDependencies(newJob->GetDependencyLinks()))
+        {
+            if (isLongestFirst)
+            {
+                sortedJobs.push_back(newJob);
+                continue;
+            }
+            readyJobs[readyCount++] = newJob;
+            if (readyCount == batchSize)
+            {
+                DispatchBulk(readyJobs, queueIndex, priority);
+                readyCount = 0;
+            }
+        }
+    }
+    if (readyCount > 0)
+    {
+        DispatchBulk({readyJobs.data(), readyCount}, queueIndex, priority);
+    }
+    if (!sortedJobs.empty())
+    {
+        std::ranges::stable_sort(sortedJobs, std::ranges::greater{}, [this](const Job* readyJob)
+        {
+            return durationHistory_.GetExpectedDuration(readyJob->GetDurationKey());
+        });
+        DispatchBulk(sortedJobs, queueIndex, priority);
+        sortedJobs.clear();
+    }
+}
+
+void JobSchedulerState::AddJobs(std::span<Job* const> newJobs, JobCounter& counter, int queueIndex,
+    JobPriority priority)
+{
+    counter.Add(static_cast<int>(newJobs.size()));
+    // Waiting on the counter helps this scheduler
+    counter.scheduler_ = &owner_;
+    for (auto* newJob : newJobs)
+    {
+        newJob->SetCounter(&counter);
+    }
+    AddJobs(newJobs, queueIndex, priority);
+}
+
+Job* JobSchedulerState::PopReadyJob(int queueIndex)
+{
+    if (queueIndex == MAIN_QUEUE_INDEX)
+    {
+        return mainThreadQueue_.PopNextTask();
+    }
+    if (IsCurrentWorker(queueIndex))
+    {
+        return currentWorker_->FindJob();
+    }
+    auto& queue = queues_[queueIndex];
+    if (auto* newTask = queue.PopNextTask())
+    {
+        return newTask;
+    }
+    thread_local std::uint32_t randomState = 0x9E3779B9u;
+    return Worker::StealJob(queue.GetWorkers(), nullptr, randomState);
+}
+
+void JobSchedulerState::ExecuteHelpedJob(Job* job, int queueIndex)
+{
+    if (!job->ShouldStart())
+    {
+        CountRequeue();
+        Dispatch(job, queueIndex);
+        return;
+    }
+    ExecuteJob(job, durationHistory_);
+    if (queueIndex == MAIN_QUEUE_INDEX)
+    {
+        mainThreadPendingJobs_.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+bool JobSchedulerState::SplitHint(int queueIndex) const
+{
+    if (queueIndex == MAIN_QUEUE_INDEX || !IsActive())
+    {
+        return false;
+    }
+    const auto& queue = queues_[queueIndex];
+    if (queue.GetWorkers().empty())
+    {
+        return false;
+    }
+    if (IsCurrentWorker(queueIndex) && currentWorker_->HasLocalJobs())
+    {
+        return false;
+    }
+    return queue.IsEmpty();
+}
+
+namespace
+{
+class ParallelForContext;
+
+/**
+ * \brief RangeJob is a split-off part of a ParallelForRange. It bypasses Job::Execute: the pending
+ * count release is the last access, after which the caller can pop the context (and this job) off
+ * its stack.
+ */
+class RangeJob : public Job
+{
+public:
+    void Set(ParallelForContext* context, std::size_t begin, std::size_t end)
+    {
+        context_ = context;
+        begin_ = begin;
+        end_ = end;
+    }
+    void Execute() override;
+protected:
+    void ExecuteImpl() override {}
+private:
+    ParallelForContext* context_ = nullptr;
+    std::size_t begin_ = 0;
+    std::size_t end_ = 0;
+};
+
+class ParallelForContext
+{
+public:
+    ParallelForContext(JobSchedulerState& scheduler, JobScheduler::RangeFunction func, void* userData,
+        int queueIndex, std::size_t grainSize) :
+        scheduler_(scheduler), func_(func), userData_(userData), queueIndex_(queueIndex), grainSize_(grainSize) {}
+
+    void Run(std::size_t begin, std::size_t end)
+    {
+        while (end - begin > grainSize_)
+        {
+            if (end - begin >= 2 * grainSize_ && scheduler_.SplitHint(queueIndex_))
+            {
+                const auto slot = usedSlots_.fetch_add(1, std::memory_order_relaxed);
+                if (slot < rangeJobs_.size())
+                {
+                    const auto middle = begin + (end - begin) / 2;
+                    pendingJobs_.fetch_add(1, std::memory_order_relaxed);
+                    rangeJobs_[slot].Set(this, middle, end);
+                    scheduler_.AddJob(&rangeJobs_[slot], queueIndex_, JobPriority::Normal);
+                    end = middle;
+                    continue;
+                }
+            }
+            func_(userData_, begin, begin + grainSize_);
+            begin += grainSize_;
+        }
+        func_(userData_, begin, end);
+    }
+
+    void Release()
+    {
+        // The waiter may return and destroy the context as soon as the count reaches zero
+        auto& waitQueue = scheduler_.GetWaitQueue(queueIndex_);
+        if (pendingJobs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            // The waiter may be parked among the workers, wake everyone so that it is woken too
+            waitQueue.Wake(std::numeric_limits<std::size_t>::max());
+        }
+    }
+
+    void SetException(std::exception_ptr exception)
+    {
+        bool expected = false;
+        if (hasException_.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+        {
+            exception_ = std::move(exception);
+        }
+    }
+
+    void RethrowIfFailed() const
+    {
+        if (exception_ != nullptr)
+        {
+            std::rethrow_exception(exception_);
+        }
+    }
+
+    void Wait()
+    {
+        auto& waitQueue = scheduler_.GetWaitQueue(queueIndex_);
+        const auto& policy = waitQueue.GetIdlePolicy();
+        std::uint32_t idlePolls = 0;
+        while (pendingJobs_.load(std::memory_order_acquire) > 0)
+        {
+            auto* newTask = scheduler_.PopReadyJob(queueIndex_);
+            if (newTask == nullptr && idlePolls >= policy.spinCount + policy.yieldCount)
+            {
+                // Parked until a job is added to the queue, or until the last range job is released
+                newTask = waitQueue.Park([this] { return scheduler_.PopReadyJob(queueIndex_); },
+                    [this] { return pendingJobs_.load(std::memory_order_acquire) == 0; });
+            }
+            if (newTask != nullptr)
+            {
+                scheduler_.ExecuteHelpedJob(newTask, queueIndex_);
+                idlePolls = 0;
+            }
+            else if (idlePolls++ < policy.spinCount)
+            {
+                CpuPause();
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+private:
+    // Splitting halves the range, so 64 jobs is enough for any realistic worker count
+    static constexpr std::size_t maxRangeJobs = 64;
+
+    JobSchedulerState& scheduler_;
+    JobScheduler::RangeFunction func_;
+    void* userData_;
+    int queueIndex_;
+    std::size_t grainSize_;
+    std::atomic<int> pendingJobs_{0};
+    std::atomic<std::size_t> usedSlots_{0};
+    // Only the first exception is kept, and rethrown on the caller once every range job is done
+    std::atomic<bool> hasException_{false};
+    std::exception_ptr exception_;
+    std::array<RangeJob, maxRangeJobs> rangeJobs_{};
+};
+
+void RangeJob::Execute()
+{
+#ifdef TRACY_ENABLE
+    ZoneScoped;
+#endif
+    NEKO_PROFILE_ZONE("RangeJob::Execute");
+    auto* context = context_;
+    try
+    {
+        context->Run(begin_, end_);
+    }
+    catch (...)
+    {
+        context->SetException(std::current_exception());
+    }
+    context->Release();
+}
+}
+
+void JobSchedulerState::ParallelForRange(std::size_t begin, std::size_t end, JobScheduler::RangeFunction func,
+    void* userData, int queueIndex, std::size_t grainSize)
+{
+#ifdef TRACY_ENABLE
+    ZoneScoped;
+#endif
+    NEKO_PROFILE_ZONE("JobScheduler::ParallelForRange");
+    if (end <= begin)
+    {
+        return;
+    }
+    if (grainSize == 0)
+    {
+        // Small enough for the splits to balance the load, large enough to amortize the split hint
+        const auto workerCount = queueIndex == MAIN_QUEUE_INDEX ? 0 : queues_[queueIndex].GetWorkers().size();
+        grainSize = std::max<std::size_t>(1, (end - begin) / (32 * (workerCount + 1)));
+    }
+    ParallelForContext context{*this, func, userData, queueIndex, grainSize};
+    try
+    {
+        context.Run(begin, end);
+    }
+    catch (...)
+    {
+        context.SetException(std::current_exception());
+    }
+    // The range jobs point to the context, so wait for them even when unwinding
+    context.Wait();
+    context.RethrowIfFailed();
+}
+
+void JobSchedulerState::ExecuteMainThread()
+{
+    auto* previousCounters = std::exchange(currentCounters_, &mainThreadCounters_);
+    while (mainThreadPendingJobs_.load(std::memory_order_acquire) > 0)
+    {
+        // Jobs still waiting on their dependencies are not in the queue yet, wait until dispatched
+        Job* newTask = mainThreadQueue_.PopNextTask();
+        if (newTask == nullptr)
+        {
+            const auto idleStart = ThreadCounters::Now();
+            newTask = mainThreadQueue_.WaitJob([this] { return mainThreadQueue_.PopNextTask(); },
+                [this] { return mainThreadPendingJobs_.load(std::memory_order_acquire) == 0; });
+            mainThreadCounters_.AddIdle(ThreadCounters::Now() - idleStart);
+        }
+        if (newTask == nullptr)
+        {
+            continue;
+        }
+        if (!newTask->ShouldStart())
+        {
+            mainThreadCounters_.AddRequeue();
+            mainThreadQueue_.AddJob(newTask);
+            std::this_thread::yield();
+        }
+        else
+        {
+            ExecuteJob(newTask, durationHistory_);
+            mainThreadPendingJobs_.fetch_sub(1, std::memory_order_release);
+        }
+    }
+    currentCounters_ = previousCounters;
+}
+
+std::size_t JobSchedulerState::ExecuteMainThread(const MainThreadBudget& budget)
+{
+#ifdef TRACY_ENABLE
+    ZoneScoped;
+#endif
+    NEKO_PROFILE_ZONE("JobScheduler::ExecuteMainThread");
+    auto* previousCounters = std::exchange(currentCounters_, &mainThreadCounters_);
+    std::size_t executedCount = 0;
+    // Not ready jobs are held until the end instead of going back to the queue right away, so that each
+    // of them is popped at most once per call and the loop cannot spin on them. The buffer is kept across
+    // calls to stay off the heap every frame, a nested call from a job only touches the jobs it held.
+    const auto heldBegin = heldMainThreadJobs_.size();
+    while (executedCount < budget.maxJobCount && std::chrono::steady_clock::now() < budget.deadline)
+    {
+        Job* newTask = mainThreadQueue_.PopNextTask();
+        if (newTask == nullptr)
+        {
+            break;
+        }
+        if (!newTask->ShouldStart())
+        {
+            mainThreadCounters_.AddRequeue();
+            heldMainThreadJobs_.push_back(newTask);
+            continue;
+        }
+        ExecuteJob(newTask, durationHistory_);
+        mainThreadPendingJobs_.fetch_sub(1, std::memory_order_release);
+        executedCount++;
+    }
+    for (auto i = heldBegin; i < heldMainThreadJobs_.size(); i++)
+    {
+        mainThreadQueue_.AddJob(heldMainThreadJobs_[i]);
+    }
+    heldMainThreadJobs_.resize(heldBegin);
+    currentCounters_ = previousCounters;
+    return executedCount;
+}
+
+void JobSchedulerState::HelpWhileWaiting(JobScheduler::WaitPredicate isDone, const void* userData)
+{
+    int queueIndex = MAIN_QUEUE_INDEX;
+    if (currentWorker_ != nullptr && currentWorker_->GetScheduler() == this)
+    {
+        queueIndex = static_cast<int>(currentWorker_->GetQueueIndex());
+    }
+    else if (std::this_thread::get_id() != mainThreadId_)
+    {
+        // Workers of another scheduler and foreign threads only block
+        return;
+    }
+    if (helpDepth_ >= JobScheduler::maxHelpDepth || !IsRunning())
+    {
+        return;
+    }
+#ifdef TRACY_ENABLE
+    ZoneScoped;
+#endif
+    NEKO_PROFILE_ZONE("JobScheduler::HelpWhileWaiting");
+    helpDepth_++;
+    auto* previousCounters = currentCounters_;
+    if (queueIndex == MAIN_QUEUE_INDEX)
+    {
+        currentCounters_ = &mainThreadCounters_;
+    }
+    const auto& policy = queueIndex == MAIN_QUEUE_INDEX ? mainThreadQueue_.GetIdlePolicy() :
+        queues_[queueIndex].GetIdlePolicy();
+    std::uint32_t idlePolls = 0;
+    while (!isDone(userData))
+    {
+        if (auto* newTask = PopReadyJob(queueIndex))
+        {
+            ExecuteHelpedJob(newTask, queueIndex);
+            idlePolls = 0;
+            continue;
+        }
+        // Nothing to help with, the awaited work runs on another thread
+        if (idlePolls >= policy.spinCount + policy.yieldCount)
+        {
+            if (queueIndex != MAIN_QUEUE_INDEX || mainThreadPendingJobs_.load(std::memory_order_acquire) == 0)
+            {
+                break;
+            }
+            // Main thread jobs still waiting on their dependencies can only run here though. The main
+            // thread parks until one is added to its queue, or until the awaited work calls NotifyWaiters.
+            if (auto* newTask = mainThreadQueue_.Park([this] { return mainThreadQueue_.PopNextTask(); },
+                [this, isDone, userData]
+                {
+                    return isDone(userData) || mainThreadPendingJobs_.load(std::memory_order_acquire) == 0;
+                }))
+            {
+                ExecuteHelpedJob(newTask, MAIN_QUEUE_INDEX);
+                idlePolls = 0;
+            }
+            continue;
+        }
+        if (idlePolls++ < policy.spinCount)
+        {
+            CpuPause();
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    currentCounters_ = previousCounters;
+    helpDepth_--;
+}
+
+JobSystemStats JobSchedulerState::GetStats() const
+{
+    JobSystemStats stats{};
+    stats.mainThread = mainThreadCounters_.GetStats();
+    stats.queues.resize(queues_.size());
+    for (std::size_t i = 0; i < stats.queues.size(); i++)
+    {
+        stats.queues[i].queueIndex = static_cast<int>(i);
+    }
+    stats.workers.reserve(workers_.size());
+    for (const auto& worker : workers_)
+    {
+        const auto workerStats = worker.GetStats();
+        auto& queueStats = stats.queues[static_cast<std::size_t>(workerStats.queueIndex)];
+        queueStats.executedJobs += workerStats.executedJobs;
+        queueStats.requeuedJobs += workerStats.requeuedJobs;
+        queueStats.busyTime += workerStats.busyTime;
+        queueStats.idleTime += workerStats.idleTime;
+        queueStats.startLatency += workerStats.startLatency;
+        stats.workers.push_back(workerStats);
+    }
+    return stats;
+}
+
+TimerId JobSchedulerState::AddTimer(Job* job, TimerWheel::Clock::duration delay, TimerWheel::Clock::duration period,
+    int queueIndex, JobPriority priority)
+{
+    if (delay <= TimerWheel::Clock::duration::zero() && period == TimerWheel::Clock::duration::zero())
+    {
+        AddJob(job, queueIndex, priority);
+        return INVALID_TIMER_ID;
+    }
+    std::scoped_lock lock(timerMutex_);
+    if (!timerThread_.joinable())
+    {
+        stopTimers_ = false;
+        timerThread_ = std::thread(&JobSchedulerState::RunTimers, this);
+    }
+    const auto timerId = timerWheel_.Add(job, TimerWheel::Clock::now() + delay, period, queueIndex, priority);
+    // Only an earlier deadline needs to wake the timer thread up
+    if (timerWheel_.GetNextDeadline() < timerWakeTime_)
+    {
+        timerCondition_.notify_one();
+    }
+    return timerId;
+}
+
+bool JobSchedulerState::CancelTimer(TimerId timerId)
+{
+    std::scoped_lock lock(timerMutex_);
+    return timerWheel_.Cancel(timerId);
+}
+
+void JobSchedulerState::RunTimers()
+{
+#ifdef TRACY_ENABLE
+    tracy::SetThreadName("Timer");
+#endif
+    NEKO_PROFILE_THREAD_NAME("Timer");
+    std::vector<ExpiredTimer> expired;
+    std::unique_lock lock(timerMutex_);
+    while (!stopTimers_)
+    {
+        timerWheel_.Advance(TimerWheel::Clock::now(), expired);
+        if (!expired.empty())
+        {
+            timerWakeTime_ = TimerWheel::Clock::time_point::min();
+            lock.unlock();
+            DispatchTimers(expired);
+            expired.clear();
+            lock.lock();
+            continue;
+        }
+        const auto deadline = timerWheel_.GetNextDeadline();
+        timerWakeTime_ = deadline.value_or(TimerWheel::Clock::time_point::max());
+        if (deadline.has_value())
+        {
+            timerCondition_.wait_until(lock, *deadline);
+        }
+        else
+        {
+            timerCondition_.wait(lock);
+        }
+    }
+}
+
+void JobSchedulerState::DispatchTimers(std::span<ExpiredTimer> expired)
+{
+#ifdef TRACY_ENABLE
+    ZoneScoped;
+#endif
+    NEKO_PROFILE_ZONE("JobScheduler::DispatchTimers");
+    // One bulk add per queue and priority
+    std::ranges::stable_sort(expired, {}, [](const ExpiredTimer& timer)
+    {
+        return std::pair{timer.queueIndex, timer.priority};
+    });
+    std::vector<Job*> batch;
+    for (std::size_t i = 0; i < expired.size();)
+    {
+        const auto queueIndex = expired[i].queueIndex;
+        const auto priority = expired[i].priority;
+        batch.clear();
+        for (; i < expired.size() && expired[i].queueIndex == queueIndex && expired[i].priority == priority; i++)
+        {
+            // Re-adding a periodic job still queued or running would reset it
+            if (!expired[i].isRepeat || expired[i].job->IsDone())
+            {
+                batch.push_back(expired[i].job);
+            }
+        }
+        if (!batch.empty())
+        {
+            AddJobs(batch, queueIndex, priority);
+        }
+    }
+}
+
+void JobSchedulerState::StopTimers()
+{
+    {
+        std::scoped_lock lock(timerMutex_);
+        if (!timerThread_.joinable())
+        {
+            return;
+        }
+        stopTimers_ = true;
+    }
+    timerCondition_.notify_one();
+    timerThread_.join();
+    // The pending timers are dropped, the next timer starts a new thread
+    timerWheel_ = TimerWheel{};
+    timerWakeTime_ = TimerWheel::Clock::time_point::max();
+}
+
+JobScheduler::JobScheduler() : state_(std::make_unique<JobSchedulerState>(*this))
+{
+}
+
+JobScheduler::~JobScheduler()
+{
+    if (IsRunning())
+    {
+        End();
+    }
+}
+
+int JobScheduler::SetupNewQueue(int threadCount, QueueMode mode)
+{
+    return state_->SetupNewQueue(threadCount, mode, {});
+}
+
+int JobScheduler::SetupNewQueue(int threadCount, const AffinityPolicy& affinity, QueueMode mode)
+{
+    return state_->SetupNewQueue(threadCount, mode, affinity.Assign(CpuTopology::Get(), threadCount));
+}
+
+void JobScheduler::SetPriorityAging(int queueIndex, std::uint32_t interval)
+{
+    state_->SetPriorityAging(queueIndex, interval);
+}
+
+void JobScheduler::SetIdlePolicy(int queueIndex, const IdlePolicy& policy)
+{
+    state_->SetIdlePolicy(queueIndex, policy);
+}
+
+void JobScheduler::Begin()
+{
+    state_->Begin();
+}
+
+void JobScheduler::Pause()
+{
+    state_->Pause();
+}
+
+void JobScheduler::Resume()
+{
+    state_->Resume();
+}
+
+void JobScheduler::End()
+{
+    state_->End();
+}
+
+bool JobScheduler::IsRunning() const
+{
+    return state_->IsRunning();
+}
+
+bool JobScheduler::IsPaused() const
+{
+    return state_->IsPaused();
+}
+
+void JobScheduler::AddJob(Job* newJob, int queueIndex, JobPriority priority)
+{
+    state_->AddJob(newJob, queueIndex, priority);
+}
+
+void JobScheduler::ReserveMainThreadJobs(int count)
+{
+    state_->AddMainThreadPending(count);
+}
+
+void JobScheduler::AddReservedMainThreadJob(Job* newJob)
+{
+    state_->AddJob(newJob, MAIN_QUEUE_INDEX, JobPriority::Normal, true);
+}
+
+void JobScheduler::AddJobs(std::span<Job* const> newJobs, int queueIndex, JobPriority priority)
+{
+    state_->AddJobs(newJobs, queueIndex, priority);
+}
+
+void JobScheduler::AddJobs(std::span<Job* const> newJobs, JobCounter& counter, int queueIndex, JobPriority priority)
+{
+    state_->AddJobs(newJobs, counter, queueIndex, priority);
+}
+
+void JobScheduler::ExecuteMainThread()
+{
+    state_->ExecuteMainThread();
+}
+
+std::size_t JobScheduler::ExecuteMainThread(const MainThreadBudget& budget)
+{
+    return state_->ExecuteMainThread(budget);
+}
+
+void JobScheduler::HelpWhileWaiting(WaitPredicate isDone, const void* userData)
+{
+    state_->HelpWhileWaiting(isDone, userData);
+}
+
+void JobScheduler::NotifyWaiters()
+{
+    state_->NotifyWaiters();
+}
+
+void JobScheduler::ParallelForRange(std::size_t begin, std::size_t end, RangeFunction func, void* userData,
+    int queueIndex, std::size_t grainSize)
+{
+    state_->ParallelForRange(begin, end, func, userData, queueIndex, grainSize);
+}
+
+JobSystemStats JobScheduler::GetStats() const
+{
+    return state_->GetStats();
+}
+
+TimerId JobScheduler::AddJobAfter(Job* job, std::chrono::steady_clock::duration delay, int queueIndex,
+    JobPriority priority)
+{
+    return state_->AddTimer(job, delay, std::chrono::steady_clock::duration::zero(), queueIndex, priority);
+}
+
+TimerId JobScheduler::AddPeriodicJob(Job* job, std::chrono::steady_clock::duration period, int queueIndex,
+    JobPriority priority)
+{
+    // A zero period would be a one-shot timer, the wheel rounds it up to one tick instead
+    period = std::max(period, std::chrono::steady_clock::duration{1});
+    return state_->AddTimer(job, period, period, queueIndex, priority);
+}
+
+bool JobScheduler::CancelTimer(TimerId timerId)
+{
+    return state_->CancelTimer(timerId);
+}
+
+std::chrono::nanoseconds JobScheduler::GetExpectedDuration(DurationKey key) const
+{
+    return state_->GetDurationHistory().GetExpectedDuration(key);
+}
+
+std::vector<DurationRecord> JobScheduler::ExportDurationHistory() const
+{
+    return state_->GetDurationHistory().Export();
+}
+
+void JobScheduler::ImportDurationHistory(std::span<const DurationRecord> records)
+{
+    state_->GetDurationHistory().Import(records);
+}
+
+namespace JobSystem
+{
+JobScheduler& GetScheduler()
+{
+    static JobScheduler scheduler;
+    return scheduler;
+}
+
+int SetupNewQueue(int threadCount, QueueMode mode)
+{
+    return GetScheduler().SetupNewQueue(threadCount, mode);
+}
+
+int SetupNewQueue(int threadCount, const AffinityPolicy& affinity, QueueMode mode)
+{
+    return GetScheduler().SetupNewQueue(threadCount, affinity, mode);
+}
+
+void Begin()
+{
+    GetScheduler().Begin();
+}
+
+void Pause()
+{
+    GetScheduler().Pause();
+}
+
+void Resume()
+{
+    GetScheduler().Resume();
+}
+
+void AddJob(Job* newJob, int queueIndex, JobPriority priority)
+{
+    GetScheduler().AddJob(newJob, queueIndex, priority);
+}
+
+void AddJobs(std::span<Job* const> newJobs, int queueIndex, JobPriority priority)
+{
+    GetScheduler().AddJobs(newJobs, queueIndex, priority);
+}
+
+void AddJobs(std::span<Job* const> newJobs, JobCounter& counter, int queueIndex, JobPriority priority)
+{
+    GetScheduler().AddJobs(newJobs, counter, queueIndex, priority);
+}
+
+void SetPriorityAging(int queueIndex, std::uint32_t interval)
+{
+    GetScheduler().SetPriorityAging(queueIndex, interval);
+}
+
+void SetIdlePolicy(int queueIndex, const IdlePolicy& policy)
+{
+    GetScheduler().SetIdlePolicy(queueIndex, policy);
+}
+
+JobSystemStats GetStats()
+{
+    return GetScheduler().GetStats();
+}
+
+TimerId AddJobAfter(Job* job, std::chrono::steady_clock::duration delay, int queueIndex, JobPriority priority)
+{
+    return GetScheduler().AddJobAfter(job, delay, queueIndex, priority);
+}
+
+TimerId AddPeriodicJob(Job* job, std::chrono::steady_clock::duration period, int queueIndex, JobPriority priority)
+{
+    return GetScheduler().AddPeriodicJob(job, period, queueIndex, priority);
+}
+
+bool CancelTimer(TimerId timerId)
+{
+    return GetScheduler().CancelTimer(timerId);
+}
+
+std::chrono::nanoseconds GetExpectedDuration(DurationKey key)
+{
+    return GetScheduler().GetExpectedDuration(key);
+}
+
+std::vector<DurationRecord> ExportDurationHistory()
+{
+    return GetScheduler().ExportDurationHistory();
+}
+
+void ImportDurationHistory(std::span<const DurationRecord> records)
+{
+    GetScheduler().ImportDurationHistory(records);
+}
+
+FunctionJob* AcquireFunctionJob()
+{
+    return JobPool::GetThreadPool().Acquire();
+}
+
+std::size_t GetFunctionJobSlotCount()
+{
+    return JobPool::GetThreadPool().GetSlotCount();
+}
+
+void End()
+{
+    GetScheduler().End();
 }
 
 void ExecuteMainThread()
 {
-    while (auto newTask = mainThreadQueue_.PopNextTask())
+    GetScheduler().ExecuteMainThread();
+}
+
+std::size_t ExecuteMainThread(const MainThreadBudget& budget)
+{
+    return GetScheduler().ExecuteMainThread(budget);
+}
+
+void HelpWhileWaiting(WaitPredicate isDone, const void* userData)
+{
+    GetScheduler().HelpWhileWaiting(isDone, userData);
+}
+
+void NotifyWaiters()
+{
+    GetScheduler().NotifyWaiters();
+}
+
+void ParallelForRange(std::size_t begin, std::size_t end, RangeFunction func, void* userData,
+    int queueIndex, std::size_t grainSize)
+{
+    GetScheduler().ParallelForRange(begin, end, func, userData, queueIndex, grainSize);
+}
+}
+
+bool Job::WaitForDependencies(std::span<DependencyLink> links)
+{
+    // Every dispatch to the main queue is counted, so that ExecuteMainThread waits for the resumption
+    const bool isMainThreadJob = queueIndex_ == MAIN_QUEUE_INDEX;
+    auto& scheduler = GetSchedulerOrDefault();
+    if (isMainThreadJob)
     {
-        if (!newTask->ShouldStart())
-        {
-            mainThreadQueue_.AddJob(newTask);
-            std::this_thread::yield();
-        }
-        else
+        scheduler.state_->AddMainThreadPending(1);
+    }
+    if (ArmDependencies(links))
+    {
+        if (isMainThreadJob)
         {
-            newTask->Execute();
+            scheduler.state_->AddMainThreadPending(-1);
         }
+        return false;
     }
+    return true;
 }
 
+JobScheduler& Job::GetSchedulerOrDefault() const
+{
+    return scheduler_ != nullptr ? *scheduler_ : JobSystem::GetScheduler();
+}
 
+void Job::ReleaseContinuations(DependencyLink* continuations)
+{
+    while (continuations != nullptr)
+    {
+        // Read the next link first, a released job may be rescheduled and relink this one
+        auto* link = continuations;
+        continuations = link->next;
+        if (link->dependent->ReleaseDependency())
+        {
+            auto* dependent = link->dependent;
+            dependent->GetSchedulerOrDefault().state_->Dispatch(dependent, dependent->queueIndex_);
+        }
+    }
 }
-void Worker::Run() const
+
+void Worker::Run()
 {
 #ifdef TRACY_ENABLE
     // Tracy copies the string, so a local buffer is fine.
@@ -428,72 +2106,363 @@ void Worker::Run() const
     std::snprintf(threadName, sizeof(threadName), "Worker q%zu/%zu", queueIndex_, workerIndex_);
     tracy::SetThreadName(threadName);
 #endif
-    auto& queue = JobSystem::queues_[queueIndex_];
-    constexpr std::int64_t waitTimeoutUsecs = 250;
-    while(JobSystem::isRunning_.load(std::memory_order_acquire))
+#ifdef NEKO_PROFILER_ENABLE
+    char profilerThreadName[32];
+    std::snprintf(profilerThreadName, sizeof(profilerThreadName), "Worker q%zu/%zu", queueIndex_, workerIndex_);
+    NEKO_PROFILE_THREAD_NAME(profilerThreadName);
+#endif
+    if (!cpus_.empty())
     {
-        Job* newTask = nullptr;
-        if (!queue.WaitDequeue(newTask, waitTimeoutUsecs) || newTask == nullptr)
+        // Best effort: a refused affinity (restricted cpuset, unsupported platform) keeps the OS placement
+        SetCurrentThreadAffinity(cpus_);
+    }
+    currentWorker_ = this;
+    currentCounters_ = counters_.get();
+    auto& queue = scheduler_->GetQueue(queueIndex_);
+    while (true)
+    {
+        while(scheduler_->IsActive())
         {
-            continue;
-        }
+            Job* newTask = FindJob();
+            if (newTask == nullptr)
+            {
+                const auto idleStart = ThreadCounters::Now();
+                newTask = queue.WaitJob([this] { return FindJob(); },
+                    [this] { return !scheduler_->IsActive(); });
+                counters_->AddIdle(ThreadCounters::Now() - idleStart);
+            }
+            if (newTask == nullptr)
+            {
+                continue;
+            }
 
-        if (!newTask->ShouldStart())
+            // Jobs are only dispatched once their dependencies are done, this only catches custom
+            // ShouldStart overrides.
+            if (!newTask->ShouldStart())
+            {
+                // Not-ready jobs always go back to the shared queue, re-pushing them on the local deque
+                // would pop them again right away.
+                counters_->AddRequeue();
+                queue.AddJob(newTask);
+                std::this_thread::yield();
+                continue;
+            }
+            ExecuteJob(newTask, scheduler_->GetDurationHistory());
+        }
+        // Even when not running anymore we still need to finish the remaining jobs, before parking
+        // on a pause or exiting on End
+        const auto pauseGeneration = scheduler_->GetPauseGeneration();
+        Drain();
+        if (!scheduler_->WaitWhilePaused(pauseGeneration))
         {
-            queue.AddJob(newTask);
-            std::this_thread::yield();
-            continue;
+            break;
         }
-        newTask->Execute();
     }
-    // Even when not running anymore we still need to finish the remaining jobs
-    while (!queue.IsEmpty())
+    currentCounters_ = nullptr;
+    currentWorker_ = nullptr;
+}
+
+void Worker::Drain()
+{
+    auto& queue = scheduler_->GetQueue(queueIndex_);
+    while (!queue.IsEmpty() || HasLocalJobs())
     {
-        auto newTask = queue.PopNextTask();
+        auto newTask = FindJob();
         if (newTask == nullptr)
             continue;
         if (!newTask->ShouldStart())
         {
+            counters_->AddRequeue();
             queue.AddJob(newTask);
             std::this_thread::yield();
         }
         else
         {
-            newTask->Execute();
+            ExecuteJob(newTask, scheduler_->GetDurationHistory());
+        }
+    }
+}
+
+ThreadStats Worker::GetStats() const
+{
+    auto stats = counters_->GetStats();
+    stats.queueIndex = static_cast<int>(queueIndex_);
+    stats.workerIndex = workerIndex_;
+    return stats;
+}
+
+Job* Worker::FindJob()
+{
+    Job* newTask = nullptr;
+    auto& queue = scheduler_->GetQueue(queueIndex_);
+    // High priority jobs must not wait behind the local jobs
+    if (queue.HasHighPriorityJobs() && (newTask = queue.PopNextTask()) != nullptr)
+    {
+        return newTask;
+    }
+    if (!workStealing_ && (newTask = PopLifo()) != nullptr)
+    {
+        return newTask;
+    }
+    // FIFO queues only hold the rest of a batch locally, taken from the top to keep the queue order
+    if (workStealing_ ? deque_->Pop(newTask) : deque_->Steal(newTask))
+    {
+        return newTask;
+    }
+    if ((newTask = PopBatch()) != nullptr)
+    {
+        return newTask;
+    }
+    return StealJob(queue.GetWorkers(), this, randomState_);
+}
+
+Job* Worker::PopLifo()
+{
+    Job* lifoJob = nullptr;
+    if (lifoSlot_->load(std::memory_order_relaxed) != nullptr)
+    {
+        lifoJob = lifoSlot_->exchange(nullptr, std::memory_order_acq_rel);
+    }
+    if (lifoJob == nullptr)
+    {
+        lifoStreak_ = 0;
+        return nullptr;
+    }
+    if (++lifoStreak_ > maxLifoStreak)
+    {
+        lifoStreak_ = 0;
+        scheduler_->GetQueue(queueIndex_).AddJob(lifoJob);
+        return nullptr;
+    }
+    return lifoJob;
+}
+
+Job* Worker::PopBatch()
+{
+    auto& queue = scheduler_->GetQueue(queueIndex_);
+    // Only take this worker's share, so that a short queue still spreads over all the workers
+    const auto workerCount = std::max<std::size_t>(queue.GetWorkers().size(), 1);
+    const auto batchSize = std::clamp<std::size_t>(queue.SizeApprox() / workerCount, 1, maxBatchSize);
+    std::array<Job*, maxBatchSize> batch{};
+    const auto count = queue.PopNextTasks({batch.data(), batchSize});
+    if (count <= 1)
+    {
+        return batch[0];
+    }
+    if (workStealing_)
+    {
+        // Pop is LIFO, push backwards so that the batch still runs in queue order
+        for (auto i = count - 1; i > 0; i--)
+        {
+            deque_->Push(batch[i]);
+        }
+    }
+    else
+    {
+        for (std::size_t i = 1; i < count; i++)
+        {
+            deque_->Push(batch[i]);
+        }
+    }
+    queue.Wake(count - 1);
+    return batch[0];
+}
+
+Job* Worker::StealJob(const std::vector<Worker*>& victims, Worker* thief, std::uint32_t& randomState)
+{
+    if (victims.empty())
+    {
+        return nullptr;
+    }
+    // xorshift32, only needs to spread the thieves over the victims
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    const auto start = randomState % victims.size();
+    for (std::size_t i = 0; i < victims.size(); i++)
+    {
+        auto* victim = victims[(start + i) % victims.size()];
+        Job* newTask = nullptr;
+        if (victim == thief)
+        {
+            continue;
+        }
+        if (victim->deque_->Steal(newTask))
+        {
+            return newTask;
+        }
+        // The LIFO slot last, its owner is likely to run it soon
+        if (victim->lifoSlot_->load(std::memory_order_relaxed) != nullptr &&
+            (newTask = victim->lifoSlot_->exchange(nullptr, std::memory_order_acq_rel)) != nullptr)
+        {
+            return newTask;
         }
     }
+    return nullptr;
 }
 
 
 void WorkerQueue::AddJob(Job* newJob)
 {
-    jobsQueue_.enqueue(newJob);
+    lanes_[static_cast<std::size_t>(newJob->GetPriority())].enqueue(newJob);
+    jobCount_.signal();
+    Wake();
+}
+
+void WorkerQueue::AddJobs(std::span<Job* const> newJobs, JobPriority priority)
+{
+    lanes_[static_cast<std::size_t>(priority)].enqueue_bulk(newJobs.data(), newJobs.size());
+    jobCount_.signal(static_cast<moodycamel::LightweightSemaphore::ssize_t>(newJobs.size()));
+    Wake(newJobs.size());
+}
+
+template<typename FindJobFunc, typename ShouldStopFunc>
+Job* WorkerQueue::WaitJob(FindJobFunc findJob, ShouldStopFunc shouldStop)
+{
+    for (std::uint32_t i = 0; i < idlePolicy_.spinCount; i++)
+    {
+        if (Job* newTask = findJob())
+        {
+            return newTask;
+        }
+        if (shouldStop())
+        {
+            return nullptr;
+        }
+        CpuPause();
+    }
+    for (std::uint32_t i = 0; i < idlePolicy_.yieldCount; i++)
+    {
+        if (Job* newTask = findJob())
+        {
+            return newTask;
+        }
+        if (shouldStop())
+        {
+            return nullptr;
+        }
+        std::this_thread::yield();
+    }
+    return Park(findJob, shouldStop);
+}
+
+template<typename FindJobFunc, typename ShouldStopFunc>
+Job* WorkerQueue::Park(FindJobFunc findJob, ShouldStopFunc shouldStop)
+{
+#ifdef TRACY_ENABLE
+    ZoneScopedN("Park");
+#endif
+    NEKO_PROFILE_ZONE("Park");
+    // The epoch is read before checking for work one last time: a job added after that check bumps it
+    // and the wait returns right away. The fences pair with the one in Wake, so that either this thread
+    // sees the new job, or the producer sees this sleeper.
+    const auto epoch = wakeEpoch_.load(std::memory_order_acquire);
+    sleepers_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    Job* newTask = findJob();
+    if (newTask == nullptr && !shouldStop())
+    {
+        wakeEpoch_.wait(epoch, std::memory_order_acquire);
+    }
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    return newTask;
+}
+
+void WorkerQueue::Wake(std::size_t count)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_relaxed) == 0)
+    {
+        return;
+    }
+    wakeEpoch_.fetch_add(1, std::memory_order_release);
+    if (count == 1)
+    {
+        wakeEpoch_.notify_one();
+    }
+    else
+    {
+        wakeEpoch_.notify_all();
+    }
 }
 
 bool WorkerQueue::IsEmpty() const
 {
-    // size_approx() is only an approximate empty hint; dequeue operations are the
+    // availableApprox() is only an approximate empty hint; dequeue operations are the
     // correctness gate.
-    return jobsQueue_.size_approx() == 0;
+    return jobCount_.availableApprox() == 0;
 }
 
+bool WorkerQueue::HasHighPriorityJobs() const
+{
+    return lanes_[static_cast<std::size_t>(JobPriority::High)].size_approx() != 0;
+}
 
 Job* WorkerQueue::PopNextTask()
 {
-    Job* newTask = nullptr;
-    if (!jobsQueue_.try_dequeue(newTask))
+    if (!jobCount_.tryWait())
     {
         return nullptr;
     }
-    return newTask;
+    return DequeueLane();
+}
+
+std::size_t WorkerQueue::PopNextTasks(std::span<Job*> out)
+{
+    const auto count = static_cast<std::size_t>(
+        jobCount_.tryWaitMany(static_cast<moodycamel::LightweightSemaphore::ssize_t>(out.size())));
+    if (count == 0)
+    {
+        return 0;
+    }
+    const bool aged = IsAgedDequeue();
+    std::size_t dequeued = 0;
+    // Granted jobs can be briefly invisible while their producers finish the enqueue
+    while (dequeued < count)
+    {
+        for (std::size_t i = 0; i < JOB_PRIORITY_COUNT && dequeued < count; i++)
+        {
+            const auto lane = aged ? JOB_PRIORITY_COUNT - 1 - i : i;
+            dequeued += lanes_[lane].try_dequeue_bulk(out.data() + dequeued, count - dequeued);
+        }
+    }
+    return count;
+}
+
+std::size_t WorkerQueue::SizeApprox() const
+{
+    const auto count = jobCount_.availableApprox();
+    return count > 0 ? static_cast<std::size_t>(count) : 0;
+}
+
+bool WorkerQueue::IsAgedDequeue()
+{
+    return agingInterval_ != 0 &&
+        dequeueCount_.fetch_add(1, std::memory_order_relaxed) % agingInterval_ == agingInterval_ - 1;
 }
 
-bool WorkerQueue::WaitDequeue(Job*& out, std::int64_t timeoutUsecs)
+Job* WorkerQueue::DequeueLane()
 {
-    return jobsQueue_.wait_dequeue_timed(out, timeoutUsecs);
+    const bool aged = IsAgedDequeue();
+    Job* newTask = nullptr;
+    // A granted job can be briefly invisible while its producer finishes the enqueue
+    while (true)
+    {
+        for (std::size_t i = 0; i < JOB_PRIORITY_COUNT; i++)
+        {
+            const auto lane = aged ? JOB_PRIORITY_COUNT - 1 - i : i;
+            if (lanes_[lane].try_dequeue(newTask))
+            {
+                return newTask;
+            }
+        }
+    }
 }
 
 void WorkerQueue::End()
 {
+    // Parked workers re-check isRunning_ once woken up
+    wakeEpoch_.fetch_add(1, std::memory_order_release);
+    wakeEpoch_.notify_all();
 }
 }
@@ -0,0 +1,172 @@
+#include "thread/pipeline.h"
+#include "utils/profiler.h"
+
+#ifdef TRACY_ENABLE
+#include <tracy/Tracy.hpp>
+#endif
+#include <algorithm>
+
+namespace neko
+{
+
+PipelineBase::PipelineBase(std::size_t tokenCount) : tokens_(std::max<std::size_t>(1, tokenCount))
+{
+    // The input is serial: a single token reads at a time, and numbers the items for the in order stages
+    stages_.emplace_back(StageMode::SerialOutOfOrder);
+}
+
+void PipelineBase::AddStageMode(StageMode mode)
+{
+    stages_.emplace_back(mode);
+}
+
+void PipelineBase::Start(int queueIndex, JobScheduler& scheduler)
+{
+    scheduler_ = &scheduler;
+    queueIndex_ = queueIndex;
+    inputSequence_ = 0;
+    isInputDone_ = false;
+    isStopping_.store(false, std::memory_order_relaxed);
+    exception_ = nullptr;
+    for (auto& stage : stages_)
+    {
+        stage.isBusy = false;
+        stage.nextSequence = 0;
+        stage.waitingTokens.clear();
+    }
+    // The tokens run on scheduler, Wait helps it and not the default one
+    done_.SetScheduler(&scheduler);
+    done_.Add(static_cast<int>(tokens_.size()));
+    for (std::size_t token = 0; token < tokens_.size(); token++)
+    {
+        tokens_[token] = {};
+        Resume(token);
+    }
+}
+
+void PipelineBase::Wait()
+{
+    done_.Wait();
+    if (exception_ != nullptr)
+    {
+        std::rethrow_exception(exception_);
+    }
+}
+
+void PipelineBase::RunToken(std::size_t tokenIndex)
+{
+#ifdef TRACY_ENABLE
+    ZoneScoped;
+#endif
+    NEKO_PROFILE_ZONE("Pipeline::RunToken");
+    auto& token = tokens_[tokenIndex];
+    while (true)
+    {
+        auto& stage = stages_[token.stage];
+        if (!token.ownsStage && stage.mode != StageMode::Parallel && !TryEnter(stage, tokenIndex))
+        {
+            return;
+        }
+        token.ownsStage = false;
+        if (token.stage == INPUT_STAGE)
+        {
+            bool hasItem = false;
+            if (!isInputDone_ && !isStopping_.load(std::memory_order_acquire))
+            {
+                try
+                {
+                    hasItem = ReadInput(tokenIndex);
+                }
+                catch (...)
+                {
+                    Fail(std::current_exception());
+                }
+            }
+            if (!hasItem)
+            {
+                isInputDone_ = true;
+                Leave(stage);
+                done_.Decrement();
+                return;
+            }
+            token.sequence = inputSequence_++;
+            Leave(stage);
+            token.stage++;
+            continue;
+        }
+        // Once stopping, the items in flight still go through the stages, so that the in order stages
+        // see every sequence number and release the tokens waiting behind them
+        if (!isStopping_.load(std::memory_order_acquire))
+        {
+            try
+            {
+                RunStage(token.stage - 1, tokenIndex);
+            }
+            catch (...)
+            {
+                Fail(std::current_exception());
+            }
+        }
+        if (stage.mode != StageMode::Parallel)
+        {
+            Leave(stage);
+        }
+        token.stage = token.stage + 1 == stages_.size() ? INPUT_STAGE : token.stage + 1;
+    }
+}
+
+bool PipelineBase::TryEnter(Stage& stage, std::size_t token)
+{
+    std::scoped_lock lock(stage.mutex);
+    if (!stage.isBusy && (stage.mode != StageMode::SerialInOrder || tokens_[token].sequence == stage.nextSequence))
+    {
+        stage.isBusy = true;
+        return true;
+    }
+    stage.waitingTokens.push_back(token);
+    return false;
+}
+
+void PipelineBase::Leave(Stage& stage)
+{
+    std::size_t nextToken = tokens_.size();
+    {
+        std::scoped_lock lock(stage.mutex);
+        auto it = stage.waitingTokens.begin();
+        if (stage.mode == StageMode::SerialInOrder)
+        {
+            stage.nextSequence++;
+            it = std::ranges::find_if(stage.waitingTokens, [this, &stage](std::size_t token)
+            {
+                return tokens_[token].sequence == stage.nextSequence;
+            });
+        }
+        if (it == stage.waitingTokens.end())
+        {
+            stage.isBusy = false;
+            return;
+        }
+        // The stage stays busy, handed over to the resumed token
+        nextToken = *it;
+        stage.waitingTokens.erase(it);
+        tokens_[nextToken].ownsStage = true;
+    }
+    Resume(nextToken);
+}
+
+void PipelineBase::Resume(std::size_t token)
+{
+    scheduler_->Submit([this, token] { RunToken(token); }, queueIndex_);
+}
+
+void PipelineBase::Fail(std::exception_ptr exception)
+{
+    std::scoped_lock lock(exceptionMutex_);
+    if (exception_ == nullptr)
+    {
+        exception_ = std::move(exception);
+    }
+    isStopping_.store(true, std::memory_order_release);
+}
+
+}
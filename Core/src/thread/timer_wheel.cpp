@@ -0,0 +1,239 @@
+#include "thread/timer_wheel.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+namespace neko
+{
+
+TimerWheel::TimerWheel(Clock::duration tickDuration, Clock::time_point start) :
+    tickDuration_(tickDuration), start_(start)
+{
+    heads_.fill(NONE);
+}
+
+TimerId TimerWheel::Add(Job* job, Clock::time_point dueTime, Clock::duration period, int queueIndex,
+    JobPriority priority)
+{
+    // Rounded up, a timer never fires early
+    std::uint64_t dueTick = 0;
+    if (dueTime > start_)
+    {
+        dueTick = static_cast<std::uint64_t>((dueTime - start_ + tickDuration_ - Clock::duration{1}) / tickDuration_);
+    }
+    std::uint32_t index = freeList_;
+    if (index == NONE)
+    {
+        index = static_cast<std::uint32_t>(timers_.size());
+        timers_.emplace_back();
+    }
+    else
+    {
+        freeList_ = timers_[index].next;
+    }
+    auto& timer = timers_[index];
+    timer.job = job;
+    timer.dueTick = std::max(dueTick, currentTick_ + 1);
+    timer.periodTicks = 0;
+    if (period > Clock::duration::zero())
+    {
+        timer.periodTicks = std::max<std::uint64_t>(1,
+            static_cast<std::uint64_t>((period + tickDuration_ - Clock::duration{1}) / tickDuration_));
+    }
+    timer.queueIndex = queueIndex;
+    timer.priority = priority;
+    timer.isRepeat = false;
+    count_++;
+    Insert(index);
+    return static_cast<TimerId>(timer.generation) << 32 | index;
+}
+
+bool TimerWheel::Cancel(TimerId timerId)
+{
+    const auto index = static_cast<std::uint32_t>(timerId & 0xFFFFFFFFu);
+    const auto generation = static_cast<std::uint32_t>(timerId >> 32);
+    if (index >= timers_.size() || timers_[index].generation != generation || timers_[index].list == NONE)
+    {
+        return false;
+    }
+    Unlink(index);
+    Release(index);
+    return true;
+}
+
+void TimerWheel::Advance(Clock::time_point now, std::vector<ExpiredTimer>& expired)
+{
+    if (now <= start_)
+    {
+        return;
+    }
+    const auto nowTick = static_cast<std::uint64_t>((now - start_) / tickDuration_);
+    while (currentTick_ < nowTick)
+    {
+        const auto nextTick = GetNextEventTick();
+        if (nextTick > nowTick)
+        {
+            currentTick_ = nowTick;
+            break;
+        }
+        currentTick_ = nextTick;
+        ProcessTick(nowTick, expired);
+    }
+}
+
+std::optional<TimerWheel::Clock::time_point> TimerWheel::GetNextDeadline() const
+{
+    if (count_ == 0)
+    {
+        return std::nullopt;
+    }
+    return GetTickTime(GetNextEventTick());
+}
+
+void TimerWheel::Insert(std::uint32_t index)
+{
+    auto& timer = timers_[index];
+    // The level is the highest tick digit that differs, the timer cascades down when the current tick
+    // reaches that digit of its due tick
+    const auto difference = timer.dueTick ^ currentTick_;
+    const auto level = difference == 0 ? 0 : static_cast<std::size_t>(std::bit_width(difference) - 1) / SLOT_BITS;
+    std::size_t list = OVERFLOW_LIST;
+    if (level < LEVEL_COUNT)
+    {
+        const auto slot = static_cast<std::size_t>(timer.dueTick >> (level * SLOT_BITS)) & (SLOT_COUNT - 1);
+        list = level * SLOT_COUNT + slot;
+        occupied_[level] |= std::uint64_t{1} << slot;
+    }
+    timer.list = static_cast<std::uint32_t>(list);
+    timer.previous = NONE;
+    timer.next = heads_[list];
+    if (timer.next != NONE)
+    {
+        timers_[timer.next].previous = index;
+    }
+    heads_[list] = index;
+}
+
+void TimerWheel::Unlink(std::uint32_t index)
+{
+    auto& timer = timers_[index];
+    if (timer.previous != NONE)
+    {
+        timers_[timer.previous].next = timer.next;
+    }
+    else
+    {
+        heads_[timer.list] = timer.next;
+    }
+    if (timer.next != NONE)
+    {
+        timers_[timer.next].previous = timer.previous;
+    }
+    if (heads_[timer.list] == NONE && timer.list != OVERFLOW_LIST)
+    {
+        occupied_[timer.list / SLOT_COUNT] &= ~(std::uint64_t{1} << (timer.list % SLOT_COUNT));
+    }
+    timer.list = NONE;
+}
+
+void TimerWheel::Release(std::uint32_t index)
+{
+    auto& timer = timers_[index];
+    timer.job = nullptr;
+    timer.list = NONE;
+    if (++timer.generation == 0)
+    {
+        timer.generation = 1;
+    }
+    timer.next = freeList_;
+    freeList_ = index;
+    count_--;
+}
+
+void TimerWheel::Reinsert(std::size_t list)
+{
+    auto index = heads_[list];
+    heads_[list] = NONE;
+    if (list != OVERFLOW_LIST)
+    {
+        occupied_[list / SLOT_COUNT] &= ~(std::uint64_t{1} << (list % SLOT_COUNT));
+    }
+    while (index != NONE)
+    {
+        const auto next = timers_[index].next;
+        Insert(index);
+        index = next;
+    }
+}
+
+void TimerWheel::ProcessTick(std::uint64_t nowTick, std::vector<ExpiredTimer>& expired)
+{
+    // Highest level first, its timers can land in a lower slot cascading on this same tick
+    if ((currentTick_ & ((std::uint64_t{1} << (LEVEL_COUNT * SLOT_BITS)) - 1)) == 0)
+    {
+        Reinsert(OVERFLOW_LIST);
+    }
+    for (auto level = LEVEL_COUNT - 1; level > 0; level--)
+    {
+        const auto shift = level * SLOT_BITS;
+        if ((currentTick_ & ((std::uint64_t{1} << shift) - 1)) == 0)
+        {
+            Reinsert(level * SLOT_COUNT + (static_cast<std::size_t>(currentTick_ >> shift) & (SLOT_COUNT - 1)));
+        }
+    }
+
+    const auto slot = static_cast<std::size_t>(currentTick_) & (SLOT_COUNT - 1);
+    auto index = heads_[slot];
+    heads_[slot] = NONE;
+    occupied_[0] &= ~(std::uint64_t{1} << slot);
+    while (index != NONE)
+    {
+        auto& timer = timers_[index];
+        const auto next = timer.next;
+        expired.push_back({timer.job, timer.queueIndex, timer.priority, timer.isRepeat});
+        if (timer.periodTicks == 0)
+        {
+            timer.list = NONE;
+            Release(index);
+        }
+        else
+        {
+            // Fire once for the periods missed while nobody advanced the wheel
+            timer.isRepeat = true;
+            timer.dueTick += timer.periodTicks;
+            if (timer.dueTick <= nowTick)
+            {
+                timer.dueTick += ((nowTick - timer.dueTick) / timer.periodTicks + 1) * timer.periodTicks;
+            }
+            Insert(index);
+        }
+        index = next;
+    }
+}
+
+std::uint64_t TimerWheel::GetNextEventTick() const
+{
+    auto nextTick = std::numeric_limits<std::uint64_t>::max();
+    for (std::size_t level = 0; level < LEVEL_COUNT; level++)
+    {
+        const auto shift = level * SLOT_BITS;
+        const auto position = static_cast<std::size_t>(currentTick_ >> shift) & (SLOT_COUNT - 1);
+        // Occupied slots are always ahead of the current position of their level
+        const auto ahead = position == SLOT_COUNT - 1 ? 0 : occupied_[level] & (~std::uint64_t{0} << (position + 1));
+        if (ahead != 0)
+        {
+            const auto slot = static_cast<std::uint64_t>(std::countr_zero(ahead));
+            const auto tick = (currentTick_ >> (shift + SLOT_BITS) << (shift + SLOT_BITS)) | (slot << shift);
+            nextTick = std::min(nextTick, tick);
+        }
+    }
+    if (heads_[OVERFLOW_LIST] != NONE)
+    {
+        constexpr auto topShift = LEVEL_COUNT * SLOT_BITS;
+        nextTick = std::min(nextTick, ((currentTick_ >> topShift) + 1) << topShift);
+    }
+    return nextTick;
+}
+
+}
@@ -0,0 +1,241 @@
+#include "utils/profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace neko::Profiler
+{
+
+/**
+ * \brief Registry owns the thread rings, they outlive their thread so that its last zones can still be
+ * exported. The ring of an exited thread is reused by a new thread once it has been drained.
+ */
+class Registry
+{
+public:
+    Registry() : originTicks_(Now()), originTime_(std::chrono::steady_clock::now()) {}
+
+    ThreadBuffer* Acquire()
+    {
+        std::scoped_lock lock(mutex_);
+        for (auto& entry : entries_)
+        {
+            if (!entry.isAlive && IsDrained(*entry.buffer))
+            {
+                entry.isAlive = true;
+                entry.threadId = nextThreadId_++;
+                entry.name.clear();
+                return entry.buffer.get();
+            }
+        }
+        auto& entry = entries_.emplace_back();
+        entry.buffer = std::make_unique<ThreadBuffer>();
+        entry.threadId = nextThreadId_++;
+        return entry.buffer.get();
+    }
+
+    void Release(const ThreadBuffer* buffer)
+    {
+        std::scoped_lock lock(mutex_);
+        FindEntry(buffer).isAlive = false;
+    }
+
+    void SetName(const ThreadBuffer* buffer, std::string_view name)
+    {
+        std::scoped_lock lock(mutex_);
+        FindEntry(buffer).name = name;
+    }
+
+    std::size_t Write(std::ostream& out)
+    {
+        std::scoped_lock lock(mutex_);
+        // The time stamp counter rate is measured against steady_clock over the whole capture
+        const auto ticks = Now() - originTicks_;
+        const auto time = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - originTime_).count();
+        const double nanosecondsPerTick = ticks == 0 ? 1.0 : time / static_cast<double>(ticks);
+
+        std::size_t count = 0;
+        bool isFirst = true;
+        char line[512];
+        out << R"({"displayTimeUnit":"ns","traceEvents":[)";
+        const auto writeLine = [&out, &isFirst, &line](int length)
+        {
+            if (length <= 0)
+            {
+                return;
+            }
+            out << (isFirst ? "\n" : ",\n");
+            out.write(line, std::min<std::streamsize>(length, sizeof(line) - 1));
+            isFirst = false;
+        };
+        for (auto& entry : entries_)
+        {
+            if (!entry.name.empty())
+            {
+                writeLine(std::snprintf(line, sizeof(line),
+                    R"({"name":"thread_name","ph":"M","pid":1,"tid":%u,"args":{"name":"%s"}})",
+                    entry.threadId, Escape(entry.name).c_str()));
+            }
+            auto& buffer = *entry.buffer;
+            const auto head = buffer.head_.load(std::memory_order_acquire);
+            auto tail = buffer.tail_.load(std::memory_order_relaxed);
+            for (; tail != head; tail++)
+            {
+                const auto& event = buffer.events_[tail & (ThreadBuffer::CAPACITY - 1)];
+                const auto begin = event.begin > originTicks_ ? event.begin - originTicks_ : 0;
+                const auto duration = event.end > event.begin ? event.end - event.begin : 0;
+                writeLine(std::snprintf(line, sizeof(line),
+                    R"({"name":"%s","ph":"X","pid":1,"tid":%u,"ts":%.3f,"dur":%.3f})",
+                    Escape(event.name != nullptr ? event.name : "").c_str(), entry.threadId,
+                    static_cast<double>(begin) * nanosecondsPerTick / 1000.0,
+                    static_cast<double>(duration) * nanosecondsPerTick / 1000.0));
+                count++;
+            }
+            buffer.tail_.store(tail, std::memory_order_release);
+        }
+        out << "\n]}\n";
+        return count;
+    }
+
+    void Clear()
+    {
+        std::scoped_lock lock(mutex_);
+        for (auto& entry : entries_)
+        {
+            entry.buffer->tail_.store(entry.buffer->head_.load(std::memory_order_acquire), std::memory_order_release);
+        }
+    }
+
+    std::uint64_t GetDroppedCount()
+    {
+        std::scoped_lock lock(mutex_);
+        std::uint64_t dropped = 0;
+        for (auto& entry : entries_)
+        {
+            dropped += entry.buffer->dropped_.load(std::memory_order_relaxed);
+        }
+        return dropped;
+    }
+private:
+    struct Entry
+    {
+        std::unique_ptr<ThreadBuffer> buffer;
+        std::string name;
+        std::uint32_t threadId = 0;
+        bool isAlive = true;
+    };
+
+    static bool IsDrained(const ThreadBuffer& buffer)
+    {
+        return buffer.head_.load(std::memory_order_acquire) == buffer.tail_.load(std::memory_order_acquire);
+    }
+
+    static std::string Escape(std::string_view text)
+    {
+        std::string escaped;
+        escaped.reserve(text.size());
+        for (const char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                escaped.push_back('\\');
+                escaped.push_back(c);
+            }
+            else if (static_cast<unsigned char>(c) >= 0x20)
+            {
+                escaped.push_back(c);
+            }
+        }
+        // Keeps a line in the snprintf buffer
+        if (escaped.size() > 256)
+        {
+            escaped.resize(256);
+        }
+        return escaped;
+    }
+
+    Entry& FindEntry(const ThreadBuffer* buffer)
+    {
+        return *std::ranges::find_if(entries_, [buffer](const Entry& entry) { return entry.buffer.get() == buffer; });
+    }
+
+    std::mutex mutex_;
+    std::vector<Entry> entries_;
+    std::uint32_t nextThreadId_ = 1;
+    std::uint64_t originTicks_;
+    std::chrono::steady_clock::time_point originTime_;
+};
+
+namespace
+{
+Registry& GetRegistry()
+{
+    // Never destroyed: threads still running at exit (a static scheduler that was not ended) release
+    // their ring after the static destructors
+    static auto* registry = new Registry();
+    return *registry;
+}
+
+struct ThreadSlot
+{
+    ThreadBuffer* buffer = nullptr;
+    ~ThreadSlot()
+    {
+        if (buffer != nullptr)
+        {
+            GetRegistry().Release(buffer);
+        }
+    }
+};
+
+thread_local ThreadSlot threadSlot;
+}
+
+ThreadBuffer& GetThreadBuffer()
+{
+    auto* buffer = threadSlot.buffer;
+    if (buffer == nullptr)
+    {
+        buffer = GetRegistry().Acquire();
+        threadSlot.buffer = buffer;
+    }
+    return *buffer;
+}
+
+void SetThreadName(std::string_view name)
+{
+    GetRegistry().SetName(&GetThreadBuffer(), name);
+}
+
+std::size_t WriteChromeTrace(std::ostream& out)
+{
+    return GetRegistry().Write(out);
+}
+
+bool ExportChromeTrace(std::string_view path)
+{
+    std::ofstream file{std::string(path)};
+    if (!file)
+    {
+        return false;
+    }
+    WriteChromeTrace(file);
+    return static_cast<bool>(file);
+}
+
+void Clear()
+{
+    GetRegistry().Clear();
+}
+
+std::uint64_t GetDroppedCount()
+{
+    return GetRegistry().GetDroppedCount();
+}
+
+}
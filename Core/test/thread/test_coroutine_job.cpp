@@ -0,0 +1,176 @@
+#include "thread/coroutine_job.h"
+#include "thread/job_graph.h"
+#include "gtest/gtest.h"
+
+#include <array>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+class CountingJob : public neko::Job
+{
+public:
+    explicit CountingJob(std::atomic<int>& counter) : counter_(counter) {}
+    void ExecuteImpl() override
+    {
+        counter_.fetch_add(1, std::memory_order_relaxed);
+    }
+private:
+    std::atomic<int>& counter_;
+};
+
+neko::JobTask AwaitOne(neko::Job& job, std::atomic<int>& counter, int& observed)
+{
+    co_await job;
+    observed = counter.load(std::memory_order_relaxed);
+}
+
+neko::JobTask AwaitGroup(neko::Job& first, neko::Job& second, std::atomic<int>& counter, int& observed)
+{
+    const std::array<neko::Job*, 2> jobs{&first, &second};
+    co_await std::span<neko::Job* const>{jobs};
+    observed = counter.load(std::memory_order_relaxed);
+    co_await first;
+    observed++;
+}
+
+// Outlasts the start of the main thread node awaiting it
+class SlowCountingJob : public CountingJob
+{
+public:
+    using CountingJob::CountingJob;
+    void ExecuteImpl() override
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        CountingJob::ExecuteImpl();
+    }
+};
+
+// Records whether the job it follows was already done when it ran
+class ProbeJob : public neko::Job
+{
+public:
+    explicit ProbeJob(const neko::Job& observedJob) : observedJob_(observedJob) {}
+    void ExecuteImpl() override
+    {
+        wasObservedDone_ = observedJob_.IsDone();
+    }
+    [[nodiscard]] bool WasObservedDone() const { return wasObservedDone_; }
+private:
+    const neko::Job& observedJob_;
+    bool wasObservedDone_ = false;
+};
+
+neko::JobTask Throwing()
+{
+    throw std::runtime_error("expected");
+    co_return;
+}
+}
+
+TEST(CoroutineJob, SuspendsInsteadOfBlockingTheWorker)
+{
+    // With a single worker, a blocking Join on a job queued behind the waiting one would deadlock
+    const int queueIndex = neko::JobSystem::SetupNewQueue(1);
+    neko::JobSystem::Begin();
+
+    std::atomic<int> counter{0};
+    int observed = -1;
+    CountingJob dependency{counter};
+    neko::CoroutineJob coroutineJob{AwaitOne(dependency, counter, observed)};
+    neko::JobSystem::AddJob(&coroutineJob, queueIndex);
+    neko::JobSystem::AddJob(&dependency, queueIndex);
+    coroutineJob.Join();
+    neko::JobSystem::End();
+
+    EXPECT_EQ(observed, 1);
+    EXPECT_FALSE(coroutineJob.HasFailed());
+}
+
+TEST(CoroutineJob, AwaitGroupOnMainThread)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(2);
+    neko::JobSystem::Begin();
+
+    std::atomic<int> counter{0};
+    int observed = -1;
+    CountingJob first{counter};
+    CountingJob second{counter};
+    neko::CoroutineJob coroutineJob{AwaitGroup(first, second, counter, observed)};
+    neko::JobSystem::AddJob(&coroutineJob, neko::MAIN_QUEUE_INDEX);
+    neko::JobSystem::AddJob(&first, queueIndex);
+    neko::JobSystem::AddJob(&second, queueIndex);
+    neko::JobSystem::ExecuteMainThread();
+
+    EXPECT_TRUE(coroutineJob.IsDone());
+    EXPECT_EQ(observed, 3);
+    neko::JobSystem::End();
+}
+
+TEST(CoroutineJob, ExceptionMarksFailed)
+{
+    neko::CoroutineJob coroutineJob{Throwing()};
+    coroutineJob.Execute();
+
+    EXPECT_TRUE(coroutineJob.IsDone());
+    EXPECT_TRUE(coroutineJob.HasFailed());
+}
+
+TEST(CoroutineJob, ExecutedDirectlyResumesOnDefaultScheduler)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(1);
+    neko::JobSystem::Begin();
+
+    // Never added, the coroutine resumes on the main queue of the default scheduler
+    std::atomic<int> counter{0};
+    int observed = -1;
+    CountingJob dependency{counter};
+    neko::CoroutineJob coroutineJob{AwaitOne(dependency, counter, observed)};
+    coroutineJob.Execute();
+    neko::JobSystem::AddJob(&dependency, queueIndex);
+    neko::JobSystem::ExecuteMainThread();
+    neko::JobSystem::End();
+
+    EXPECT_TRUE(coroutineJob.IsDone());
+    EXPECT_EQ(observed, 1);
+}
+
+TEST(CoroutineJob, SuspendedGraphNodeHoldsItsSuccessors)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(1);
+    neko::JobSystem::Begin();
+
+    std::atomic<int> counter{0};
+    int workerObserved = -1;
+    int mainObserved = -1;
+    CountingJob workerDependency{counter};
+    SlowCountingJob mainDependency{counter};
+    neko::CoroutineJob workerCoroutine{AwaitOne(workerDependency, counter, workerObserved)};
+    neko::CoroutineJob mainCoroutine{AwaitOne(mainDependency, counter, mainObserved)};
+    // Each successor is on the other queue, it is dispatched instead of run inline
+    ProbeJob afterWorkerCoroutine{workerCoroutine};
+    ProbeJob afterMainCoroutine{mainCoroutine};
+    neko::JobGraph graph;
+    const auto workerNode = graph.AddNode(&workerCoroutine, queueIndex);
+    const auto mainNode = graph.AddNode(&mainCoroutine, neko::MAIN_QUEUE_INDEX);
+    graph.AddEdge(workerNode, graph.AddNode(&afterWorkerCoroutine, neko::MAIN_QUEUE_INDEX));
+    graph.AddEdge(mainNode, graph.AddNode(&afterMainCoroutine, queueIndex));
+    ASSERT_TRUE(graph.Compile());
+    graph.Run();
+    // Only added once the worker coroutine awaits it, so that its node surely suspends
+    while (!workerCoroutine.HasStarted())
+    {
+        std::this_thread::yield();
+    }
+    neko::JobSystem::AddJob(&workerDependency, queueIndex);
+    neko::JobSystem::AddJob(&mainDependency, queueIndex);
+    graph.Join();
+    neko::JobSystem::End();
+
+    EXPECT_FALSE(graph.HasFailed());
+    EXPECT_NE(workerObserved, -1);
+    EXPECT_NE(mainObserved, -1);
+    EXPECT_TRUE(afterWorkerCoroutine.WasObservedDone());
+    EXPECT_TRUE(afterMainCoroutine.WasObservedDone());
+}
@@ -0,0 +1,82 @@
+#include "thread/cpu_topology.h"
+#include "thread/job_system.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+
+namespace
+{
+// 2 packages, 2 cores per package, 2 SMT siblings per core, one L3 and one NUMA node per package
+neko::CpuTopology MakeTopology()
+{
+    std::vector<neko::CpuInfo> cpus;
+    for (int cpu = 0; cpu < 8; cpu++)
+    {
+        const int package = cpu / 4;
+        const int core = package * 2 + cpu % 2;
+        cpus.push_back({cpu, package, core, package * 4, package});
+    }
+    return neko::CpuTopology{std::move(cpus)};
+}
+}
+
+TEST(CpuTopology, ParseCpuList)
+{
+    EXPECT_EQ(neko::CpuTopology::ParseCpuList("0-3,8,10-11"), (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(neko::CpuTopology::ParseCpuList("0"), (std::vector<int>{0}));
+    EXPECT_TRUE(neko::CpuTopology::ParseCpuList("").empty());
+}
+
+TEST(CpuTopology, ReadsThisMachine)
+{
+    const auto& topology = neko::CpuTopology::Get();
+    ASSERT_FALSE(topology.GetCpus().empty());
+    EXPECT_FALSE(topology.GetPhysicalCores().empty());
+}
+
+TEST(CpuTopology, AssignPolicies)
+{
+    const auto topology = MakeTopology();
+    EXPECT_EQ(topology.GetPhysicalCores(), (std::vector<int>{0, 1, 4, 5}));
+
+    const auto none = neko::AffinityPolicy::None().Assign(topology, 3);
+    ASSERT_EQ(none.size(), 3u);
+    for (const auto& cpuSet : none)
+    {
+        EXPECT_TRUE(cpuSet.empty());
+    }
+
+    const auto cores = neko::AffinityPolicy::PhysicalCores().Assign(topology, 5);
+    ASSERT_EQ(cores.size(), 5u);
+    EXPECT_EQ(cores[0], std::vector<int>{0});
+    EXPECT_EQ(cores[3], std::vector<int>{5});
+    EXPECT_EQ(cores[4], std::vector<int>{0});
+
+    const auto cache = neko::AffinityPolicy::CacheDomain(6).Assign(topology, 2);
+    EXPECT_EQ(cache[1], (std::vector<int>{4, 5, 6, 7}));
+
+    const auto numa = neko::AffinityPolicy::NumaNode(0).Assign(topology, 2);
+    EXPECT_EQ(numa[0], (std::vector<int>{0, 1, 2, 3}));
+
+    const auto sets = neko::AffinityPolicy::CpuSets({{1}, {2, 3}}).Assign(topology, 3);
+    EXPECT_EQ(sets[1], (std::vector<int>{2, 3}));
+    EXPECT_EQ(sets[2], std::vector<int>{1});
+}
+
+TEST(CpuTopology, PinnedQueueRunsJobs)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(2, neko::AffinityPolicy::PhysicalCores());
+    neko::JobSystem::Begin();
+    std::atomic<int> counter{0};
+    std::vector<neko::JobHandle> handles;
+    for (int i = 0; i < 16; i++)
+    {
+        handles.push_back(neko::JobSystem::Submit([&counter] { counter.fetch_add(1); }, queueIndex));
+    }
+    for (auto& handle : handles)
+    {
+        handle.Join();
+    }
+    neko::JobSystem::End();
+    EXPECT_EQ(counter.load(), 16);
+}
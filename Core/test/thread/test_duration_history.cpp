@@ -0,0 +1,179 @@
+#include "thread/duration_history.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using namespace std::chrono_literals;
+
+class RecordingJob : public neko::Job
+{
+public:
+    RecordingJob(std::vector<int>& order, int index) : order_(order), index_(index) {}
+protected:
+    void ExecuteImpl() override { order_.push_back(index_); }
+private:
+    std::vector<int>& order_;
+    int index_;
+};
+
+// Adds its batch from inside a worker, where a work-stealing queue pushes it on the worker own deque
+class SpawningJob : public neko::Job
+{
+public:
+    SpawningJob(std::span<neko::Job* const> batch, int queueIndex) : batch_(batch), queueIndex_(queueIndex) {}
+protected:
+    void ExecuteImpl() override { GetScheduler()->AddJobs(batch_, queueIndex_); }
+private:
+    std::span<neko::Job* const> batch_;
+    int queueIndex_;
+};
+
+class SleepingJob : public neko::Job
+{
+protected:
+    void ExecuteImpl() override { std::this_thread::sleep_for(1ms); }
+};
+}
+
+TEST(DurationHistory, MovingAverage)
+{
+    neko::DurationHistory history;
+    EXPECT_EQ(history.GetExpectedDuration(1), 0ns);
+    history.Record(1, 800ns);
+    EXPECT_EQ(history.GetExpectedDuration(1), 800ns);
+    // Each sample moves the average by an eighth of the difference
+    history.Record(1, 1600ns);
+    EXPECT_EQ(history.GetExpectedDuration(1), 900ns);
+    history.Record(neko::NO_DURATION_KEY, 1ms);
+    EXPECT_EQ(history.GetExpectedDuration(neko::NO_DURATION_KEY), 0ns);
+    EXPECT_EQ(history.GetExpectedDuration(2), 0ns);
+}
+
+TEST(DurationHistory, ConcurrentFirstSamples)
+{
+    constexpr int threadCount = 4;
+    constexpr neko::DurationKey keyCount = 1000;
+    neko::DurationHistory history;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&history, t]
+        {
+            for (neko::DurationKey key = 1; key <= keyCount; key++)
+            {
+                history.Record(key, std::chrono::microseconds(1 + t));
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    // No sample is averaged against an empty zero, every key ends within the range of its samples
+    for (const auto& record : history.Export())
+    {
+        EXPECT_GE(record.average, 1us);
+        EXPECT_LE(record.average, std::chrono::microseconds(threadCount));
+        EXPECT_EQ(record.sampleCount, static_cast<std::uint64_t>(threadCount));
+    }
+    EXPECT_EQ(history.Export().size(), static_cast<std::size_t>(keyCount));
+}
+
+TEST(DurationHistory, ExportImport)
+{
+    neko::DurationHistory history;
+    for (neko::DurationKey key = 1; key <= 100; key++)
+    {
+        history.Record(key, std::chrono::nanoseconds(key * 10));
+    }
+    auto records = history.Export();
+    ASSERT_EQ(records.size(), 100u);
+    std::ranges::sort(records, {}, &neko::DurationRecord::key);
+    EXPECT_EQ(records[41].key, 42u);
+    EXPECT_EQ(records[41].average, 420ns);
+    EXPECT_EQ(records[41].sampleCount, 1u);
+
+    neko::DurationHistory warmHistory;
+    warmHistory.Import(records);
+    EXPECT_EQ(warmHistory.GetExpectedDuration(42), 420ns);
+    // An imported average keeps moving, it is not the first sample again
+    warmHistory.Record(42, 500ns);
+    EXPECT_EQ(warmHistory.GetExpectedDuration(42), 430ns);
+
+    warmHistory.Clear();
+    EXPECT_TRUE(warmHistory.Export().empty());
+}
+
+TEST(DurationHistory, SchedulerRecordsAndOrdersLongestFirst)
+{
+    neko::JobScheduler scheduler;
+    scheduler.Begin();
+
+    SleepingJob sleepingJob;
+    sleepingJob.SetDurationKey(7);
+    scheduler.AddJob(&sleepingJob);
+    scheduler.ExecuteMainThread();
+    EXPECT_GE(scheduler.GetExpectedDuration(7), 1ms);
+    const auto records = scheduler.ExportDurationHistory();
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records.front().key, 7u);
+
+    // Warm started history: the batch starts with the longest expected job, the unknown ones keep their order last
+    const std::vector<neko::DurationRecord> warmRecords{
+        {1, 10us, 1},
+        {2, 30us, 1},
+        {3, 20us, 1},
+    };
+    scheduler.ImportDurationHistory(warmRecords);
+    std::vector<int> order;
+    std::vector<std::unique_ptr<RecordingJob>> jobs;
+    std::vector<neko::Job*> batch;
+    for (int i = 0; i < 5; i++)
+    {
+        auto& job = jobs.emplace_back(std::make_unique<RecordingJob>(order, i));
+        job->SetDurationKey(static_cast<neko::DurationKey>(i + 1));
+        batch.push_back(job.get());
+    }
+    scheduler.AddJobs(batch);
+    scheduler.ExecuteMainThread();
+    scheduler.End();
+    EXPECT_EQ(order, (std::vector<int>{1, 2, 0, 3, 4}));
+}
+
+TEST(DurationHistory, WorkerLocalBatchRunsLongestFirst)
+{
+    neko::JobScheduler scheduler;
+    // A single worker, nobody steals from its deque
+    const int queueIndex = scheduler.SetupNewQueue(1, neko::QueueMode::WorkStealing);
+    scheduler.Begin();
+    const std::vector<neko::DurationRecord> warmRecords{
+        {1, 10us, 1},
+        {2, 30us, 1},
+        {3, 20us, 1},
+    };
+    scheduler.ImportDurationHistory(warmRecords);
+
+    std::vector<int> order;
+    std::vector<std::unique_ptr<RecordingJob>> jobs;
+    std::vector<neko::Job*> batch;
+    neko::JobCounter counter;
+    for (int i = 0; i < 3; i++)
+    {
+        auto& job = jobs.emplace_back(std::make_unique<RecordingJob>(order, i));
+        job->SetDurationKey(static_cast<neko::DurationKey>(i + 1));
+        job->SetCounter(&counter);
+        batch.push_back(job.get());
+    }
+    counter.Add(static_cast<int>(batch.size()));
+    SpawningJob spawningJob(batch, queueIndex);
+    scheduler.AddJob(&spawningJob, queueIndex);
+    counter.Wait();
+    scheduler.End();
+    EXPECT_EQ(order, (std::vector<int>{1, 2, 0}));
+}
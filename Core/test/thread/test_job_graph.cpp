@@ -0,0 +1,217 @@
+#include "thread/job_graph.h"
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+class RecordingJob : public neko::Job
+{
+public:
+    RecordingJob() = default;
+    RecordingJob(std::atomic<int>* counter, bool shouldThrow = false) : counter_(counter), shouldThrow_(shouldThrow) {}
+    void ExecuteImpl() override
+    {
+        if (shouldThrow_)
+        {
+            throw std::runtime_error("expected");
+        }
+        order_ = counter_->fetch_add(1, std::memory_order_relaxed);
+    }
+    [[nodiscard]] int GetOrder() const { return order_; }
+    void SetShouldThrow(bool shouldThrow) { shouldThrow_ = shouldThrow; }
+private:
+    std::atomic<int>* counter_ = nullptr;
+    bool shouldThrow_ = false;
+    int order_ = -1;
+};
+
+class SleepingJob : public neko::Job
+{
+protected:
+    void ExecuteImpl() override { std::this_thread::sleep_for(std::chrono::milliseconds(5)); }
+};
+}
+
+TEST(JobGraph, CycleIsRejected)
+{
+    std::atomic<int> counter{0};
+    RecordingJob a{&counter}, b{&counter}, c{&counter};
+    neko::JobGraph graph;
+    const auto nodeA = graph.AddNode(&a);
+    const auto nodeB = graph.AddNode(&b);
+    const auto nodeC = graph.AddNode(&c);
+    graph.AddEdge(nodeA, nodeB);
+    graph.AddEdge(nodeB, nodeC);
+    EXPECT_TRUE(graph.Compile());
+    EXPECT_EQ(graph.GetLevel(nodeC), 2u);
+    graph.AddEdge(nodeC, nodeA);
+    EXPECT_FALSE(graph.Compile());
+}
+
+TEST(JobGraph, RunEveryFrame)
+{
+    constexpr int width = 16;
+    constexpr int frameCount = 20;
+    const int queueIndex = neko::JobSystem::SetupNewQueue(4);
+    neko::JobSystem::Begin();
+
+    // root -> width nodes -> sink
+    std::atomic<int> counter{0};
+    RecordingJob root{&counter};
+    RecordingJob sink{&counter};
+    std::vector<std::unique_ptr<RecordingJob>> middle;
+    neko::JobGraph graph;
+    const auto rootNode = graph.AddNode(&root, queueIndex);
+    const auto sinkNode = graph.AddNode(&sink, queueIndex);
+    for (int i = 0; i < width; i++)
+    {
+        middle.push_back(std::make_unique<RecordingJob>(&counter));
+        const auto node = graph.AddNode(middle.back().get(), queueIndex);
+        graph.AddEdge(rootNode, node);
+        graph.AddEdge(node, sinkNode);
+    }
+    ASSERT_TRUE(graph.Compile());
+
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+        counter.store(0);
+        graph.Run();
+        graph.Join();
+        EXPECT_FALSE(graph.HasFailed());
+        EXPECT_EQ(root.GetOrder(), 0);
+        EXPECT_EQ(sink.GetOrder(), width + 1);
+        EXPECT_TRUE(sink.IsDone());
+    }
+    neko::JobSystem::End();
+}
+
+TEST(JobGraph, FailureSkipsSuccessors)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(2);
+    neko::JobSystem::Begin();
+
+    std::atomic<int> counter{0};
+    RecordingJob failing{&counter, true};
+    RecordingJob successor{&counter};
+    RecordingJob independent{&counter};
+    neko::JobGraph graph;
+    const auto failingNode = graph.AddNode(&failing, queueIndex);
+    graph.AddEdge(failingNode, graph.AddNode(&successor, queueIndex));
+    graph.AddNode(&independent, queueIndex);
+    ASSERT_TRUE(graph.Compile());
+    graph.Run();
+    graph.Join();
+
+    EXPECT_TRUE(graph.HasFailed());
+    EXPECT_TRUE(successor.HasFailed());
+    EXPECT_EQ(successor.GetOrder(), -1);
+    EXPECT_FALSE(independent.HasFailed());
+
+    // The failure of a run does not carry over to the next one
+    failing.SetShouldThrow(false);
+    graph.Run();
+    graph.Join();
+    neko::JobSystem::End();
+
+    EXPECT_FALSE(graph.HasFailed());
+    EXPECT_FALSE(successor.HasFailed());
+    EXPECT_NE(successor.GetOrder(), -1);
+}
+
+TEST(JobGraph, MainThreadJoinRunsMainNodes)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(2);
+    neko::JobSystem::Begin();
+
+    std::atomic<int> counter{0};
+    RecordingJob worker{&counter};
+    RecordingJob main{&counter};
+    neko::JobGraph graph;
+    const auto workerNode = graph.AddNode(&worker, queueIndex);
+    const auto mainNode = graph.AddNode(&main, neko::MAIN_QUEUE_INDEX);
+    graph.AddEdge(workerNode, mainNode);
+    ASSERT_TRUE(graph.Compile());
+    for (int frame = 0; frame < 5; frame++)
+    {
+        graph.Run();
+        graph.Join();
+    }
+    neko::JobSystem::End();
+
+    EXPECT_EQ(counter.load(), 10);
+    EXPECT_EQ(main.GetOrder(), 9);
+}
+
+TEST(JobGraph, MainThreadJoinWaitsForSlowWorkerNode)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(1);
+    neko::JobSystem::Begin();
+
+    // The worker node outlasts the spin and yield polls of the helping main thread
+    std::atomic<int> counter{0};
+    SleepingJob worker;
+    RecordingJob main{&counter};
+    neko::JobGraph graph;
+    const auto workerNode = graph.AddNode(&worker, queueIndex);
+    const auto mainNode = graph.AddNode(&main, neko::MAIN_QUEUE_INDEX);
+    graph.AddEdge(workerNode, mainNode);
+    ASSERT_TRUE(graph.Compile());
+    for (int frame = 0; frame < 3; frame++)
+    {
+        graph.Run();
+        graph.Join();
+        EXPECT_TRUE(graph.IsDone());
+    }
+    // The same through ExecuteMainThread, which must not return before the main node ran
+    graph.Run();
+    neko::JobSystem::ExecuteMainThread();
+    EXPECT_TRUE(graph.IsDone());
+    neko::JobSystem::End();
+
+    EXPECT_EQ(counter.load(), 4);
+}
+
+TEST(JobGraph, ScheduleJobNode)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(1);
+    neko::JobSystem::Begin();
+
+    std::atomic<int> counter{0};
+    RecordingJob containedJob{&counter};
+    neko::ScheduleJob scheduleJob{&containedJob, queueIndex};
+    neko::JobGraph graph;
+    graph.AddNode(&scheduleJob, queueIndex);
+    ASSERT_TRUE(graph.Compile());
+    graph.Run();
+    graph.Join();
+    containedJob.Join();
+    neko::JobSystem::End();
+
+    EXPECT_FALSE(graph.HasFailed());
+    EXPECT_EQ(counter.load(), 1);
+}
+
+TEST(JobGraph, InvalidUseThrows)
+{
+    std::atomic<int> counter{0};
+    RecordingJob a{&counter};
+    neko::JobGraph graph;
+    const auto nodeA = graph.AddNode(&a);
+    EXPECT_THROW(graph.AddEdge(nodeA, nodeA + 1), std::out_of_range);
+    EXPECT_THROW(graph.AddEdge(nodeA + 1, nodeA), std::out_of_range);
+    ASSERT_TRUE(graph.Compile());
+
+    neko::JobSystem::Begin();
+    // The main queue node waits for ExecuteMainThread, the run is still in flight
+    graph.Run();
+    EXPECT_THROW(graph.Run(), std::logic_error);
+    EXPECT_THROW(graph.AddNode(&a), std::logic_error);
+    EXPECT_FALSE(graph.Compile());
+    graph.Join();
+    graph.Run();
+    graph.Join();
+    neko::JobSystem::End();
+    EXPECT_EQ(counter.load(), 2);
+}
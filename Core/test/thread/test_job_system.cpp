@@ -5,6 +5,13 @@
 #include "thread/job_system.h"
 #include "gtest/gtest.h"
 
+#include <chrono>
+#include <ctime>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
 class EmptyJob : public neko::Job
 {
     void ExecuteImpl() override {}
@@ -45,6 +52,64 @@ TEST(JobSystem, FuncJob)
     EXPECT_TRUE(job.ShouldStart());
 }
 
+class ThrowingJob : public neko::Job
+{
+    void ExecuteImpl() override { throw std::runtime_error("job"); }
+};
+
+TEST(JobSystem, JobStateTransitions)
+{
+    ThrowingJob throwingJob;
+    throwingJob.Execute();
+    EXPECT_TRUE(throwingJob.HasStarted());
+    EXPECT_TRUE(throwingJob.IsDone());
+    EXPECT_TRUE(throwingJob.HasFailed());
+    EXPECT_FALSE(throwingJob.IsCancelled());
+
+    // The cancellation is recorded in the job, it stays visible once the flag is cleared
+    std::atomic<bool> cancelled{true};
+    EmptyJob job;
+    job.SetCancelFlag(&cancelled);
+    job.Execute();
+    cancelled = false;
+    EXPECT_TRUE(job.IsDone());
+    EXPECT_TRUE(job.HasFailed());
+    EXPECT_TRUE(job.IsCancelled());
+    job.Reset();
+    EXPECT_FALSE(job.IsCancelled());
+    EXPECT_FALSE(job.HasFailed());
+    EXPECT_FALSE(job.IsDone());
+
+    // A thread blocked in Join is woken by the completion
+    ControlledJob controlledJob;
+    std::thread joiner([&controlledJob] { controlledJob.Join(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    controlledJob.SetDone();
+    joiner.join();
+    EXPECT_TRUE(controlledJob.IsDone());
+    EXPECT_TRUE(controlledJob.HasStarted());
+}
+
+TEST(JobSystem, CacheAlignedJob)
+{
+    static_assert(alignof(neko::CacheAlignedJob<EmptyJob>) == neko::CACHE_LINE_SIZE);
+    std::array<neko::CacheAlignedJob<EmptyJob>, 4> jobs;
+    EXPECT_GE(reinterpret_cast<std::uintptr_t>(&jobs[1]) - reinterpret_cast<std::uintptr_t>(&jobs[0]),
+        neko::CACHE_LINE_SIZE);
+    const int queueIndex = neko::JobSystem::SetupNewQueue(2);
+    neko::JobSystem::Begin();
+    for (auto& job : jobs)
+    {
+        neko::JobSystem::AddJob(&job, queueIndex);
+    }
+    for (auto& job : jobs)
+    {
+        job.Join();
+        EXPECT_TRUE(job.IsDone());
+    }
+    neko::JobSystem::End();
+}
+
 class EmptyDependentJob : public neko::DependentJob
 {
     using DependentJob::DependentJob;
@@ -115,6 +180,32 @@ TEST(JobSystem, CyclicDependenciesJob)
 
 }
 
+TEST(JobSystem, CyclicDependenciesDiamondLattice)
+{
+    // Every layer depends on both jobs of the previous one: 2^layerCount upstream paths, but each job is
+    // visited once per check
+    constexpr int layerCount = 64;
+    std::vector<std::array<EmptyDependenciesJob, 2>> layers(layerCount);
+    for (int layer = 1; layer < layerCount; layer++)
+    {
+        for (auto& job : layers[layer])
+        {
+            EXPECT_TRUE(job.AddDependency(&layers[layer - 1][0]));
+            EXPECT_TRUE(job.AddDependency(&layers[layer - 1][1]));
+        }
+    }
+    EXPECT_FALSE(layers[0][0].AddDependency(&layers[layerCount - 1][1]));
+    EXPECT_FALSE(layers[0][1].AddDependency(&layers[0][1]));
+    EmptyDependenciesJob last;
+    EXPECT_TRUE(last.AddDependency(&layers[layerCount - 1][0]));
+    EXPECT_FALSE(last.AddDependency(nullptr));
+
+    // Not validated, the caller vouches for the graph
+    EmptyDependenciesJob unchecked;
+    EXPECT_TRUE(unchecked.AddDependency(&last, neko::DependencyCheck::Skip));
+    EXPECT_FALSE(unchecked.AddDependency(nullptr, neko::DependencyCheck::Skip));
+}
+
 TEST(JobSystem, JobSystemSeveralQueuesEmpty)
 {
 
@@ -289,3 +380,907 @@ TEST(JobSystem, ScheduleJobCancellationDoesNotDeadlockContainedJob)
     EXPECT_TRUE(containedJob.IsDone());
     EXPECT_TRUE(containedJob.HasFailed());
 }
+
+TEST(JobSystem, ScheduleJobExecutedDirectly)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(1);
+    neko::JobSystem::Begin();
+    // Never added, it schedules the contained job on the default scheduler
+    EmptyJob containedJob;
+    neko::ScheduleJob scheduleJob{&containedJob, queueIndex};
+    scheduleJob.Execute();
+    containedJob.Join();
+    neko::JobSystem::End();
+
+    EXPECT_TRUE(scheduleJob.IsDone());
+    EXPECT_FALSE(scheduleJob.HasFailed());
+    EXPECT_TRUE(containedJob.IsDone());
+}
+
+class SpawningJob : public neko::Job
+{
+public:
+    SpawningJob(std::atomic<int>& counter, int queueIndex, std::vector<EmptyJob>& children) :
+        counter_(counter), queueIndex_(queueIndex), children_(children) {}
+    void ExecuteImpl() override
+    {
+        for (auto& child : children_)
+        {
+            neko::JobSystem::AddJob(&child, queueIndex_);
+        }
+        counter_.fetch_add(1, std::memory_order_relaxed);
+    }
+private:
+    std::atomic<int>& counter_;
+    int queueIndex_;
+    std::vector<EmptyJob>& children_;
+};
+
+TEST(JobSystem, WorkStealingQueue)
+{
+    constexpr int parentCount = 16;
+    constexpr int childCount = 64;
+    const int queueIndex = neko::JobSystem::SetupNewQueue(4, neko::QueueMode::WorkStealing);
+    neko::JobSystem::Begin();
+
+    std::atomic<int> counter{0};
+    std::vector<std::vector<EmptyJob>> children(parentCount);
+    std::vector<std::unique_ptr<SpawningJob>> parents;
+    for (auto& jobChildren : children)
+    {
+        jobChildren = std::vector<EmptyJob>(childCount);
+        parents.push_back(std::make_unique<SpawningJob>(counter, queueIndex, jobChildren));
+        neko::JobSystem::AddJob(parents.back().get(), queueIndex);
+    }
+    for (auto& parent : parents)
+    {
+        parent->Join();
+    }
+    for (auto& jobChildren : children)
+    {
+        for (auto& child : jobChildren)
+        {
+            child.Join();
+        }
+    }
+    neko::JobSystem::End();
+
+    EXPECT_EQ(counter.load(), parentCount);
+}
+
+class RecordingSpawnJob : public neko::Job
+{
+public:
+    RecordingSpawnJob(std::vector<int>& order, int id, int queueIndex) : order_(order), id_(id), queueIndex_(queueIndex) {}
+    neko::Job* child = nullptr;
+    neko::JobPriority childPriority = neko::JobPriority::Normal;
+protected:
+    void ExecuteImpl() override
+    {
+        order_.push_back(id_);
+        if (child != nullptr)
+        {
+            neko::JobSystem::AddJob(child, queueIndex_, childPriority);
+        }
+    }
+private:
+    std::vector<int>& order_;
+    int id_;
+    int queueIndex_;
+};
+
+TEST(JobSystem, FifoQueueRunsSpawnedJobNext)
+{
+    // A single worker, so that the order is deterministic
+    const int queueIndex = neko::JobSystem::SetupNewQueue(1);
+    neko::JobSystem::Begin();
+
+    std::vector<int> order;
+    RecordingSpawnJob parent(order, 0, queueIndex);
+    RecordingSpawnJob child(order, 1, queueIndex);
+    RecordingSpawnJob second(order, 2, queueIndex);
+    RecordingSpawnJob third(order, 3, queueIndex);
+    parent.child = &child;
+    // Waited through a counter: the spawned jobs cannot be joined before they are added
+    neko::JobCounter counter(4);
+    for (auto* job : {&parent, &child, &second, &third})
+    {
+        job->SetCounter(&counter);
+    }
+    neko::JobSystem::AddJob(&parent, queueIndex);
+    neko::JobSystem::AddJob(&second, queueIndex);
+    neko::JobSystem::AddJob(&third, queueIndex);
+    counter.Wait();
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 2, 3}));
+
+    // A chain of spawns cannot starve the jobs already queued
+    constexpr int chainLength = 100;
+    order.clear();
+    std::vector<std::unique_ptr<RecordingSpawnJob>> chain;
+    for (int i = 0; i < chainLength; i++)
+    {
+        chain.push_back(std::make_unique<RecordingSpawnJob>(order, i, queueIndex));
+        chain.back()->SetCounter(&counter);
+    }
+    for (int i = 0; i + 1 < chainLength; i++)
+    {
+        chain[i]->child = chain[i + 1].get();
+    }
+    RecordingSpawnJob queued(order, -1, queueIndex);
+    queued.SetCounter(&counter);
+    counter.Add(chainLength + 1);
+    neko::JobSystem::AddJob(chain.front().get(), queueIndex);
+    neko::JobSystem::AddJob(&queued, queueIndex);
+    counter.Wait();
+
+    ASSERT_EQ(order.size(), static_cast<std::size_t>(chainLength + 1));
+    const auto queuedPosition = std::ranges::find(order, -1) - order.begin();
+    EXPECT_LT(queuedPosition, chainLength / 2);
+
+    // A spawned Low job does not run next, the queued Normal one goes first
+    order.clear();
+    RecordingSpawnJob lowParent(order, 0, queueIndex);
+    RecordingSpawnJob lowChild(order, 1, queueIndex);
+    RecordingSpawnJob normal(order, 2, queueIndex);
+    lowParent.child = &lowChild;
+    lowParent.childPriority = neko::JobPriority::Low;
+    std::array<neko::Job*, 2> batch{&lowParent, &normal};
+    counter.Add(1);
+    lowChild.SetCounter(&counter);
+    // In one batch, so that the Normal job is queued before the Low one is spawned
+    neko::JobSystem::AddJobs(batch, counter, queueIndex);
+    counter.Wait();
+    neko::JobSystem::End();
+    EXPECT_EQ(order, (std::vector<int>{0, 2, 1}));
+}
+
+class OrderedDependentJob : public neko::DependentJob
+{
+public:
+    OrderedDependentJob(Job* dependency, std::atomic<int>& counter) :
+        DependentJob(dependency), counter_(counter) {}
+    void ExecuteImpl() override
+    {
+        order_ = counter_.fetch_add(1, std::memory_order_relaxed);
+    }
+    [[nodiscard]] int GetOrder() const { return order_; }
+private:
+    std::atomic<int>& counter_;
+    int order_ = -1;
+};
+
+TEST(JobSystem, DependencyChainRunsInOrder)
+{
+    constexpr int chainLength = 256;
+    const int queueIndex = neko::JobSystem::SetupNewQueue(4);
+    neko::JobSystem::Begin();
+
+    std::atomic<int> counter{0};
+    EmptyJob root;
+    std::vector<std::unique_ptr<OrderedDependentJob>> chain;
+    neko::Job* previous = &root;
+    for (int i = 0; i < chainLength; i++)
+    {
+        chain.push_back(std::make_unique<OrderedDependentJob>(previous, counter));
+        previous = chain.back().get();
+    }
+    neko::JobSystem::AddJob(&root, queueIndex);
+    for (auto& job : chain)
+    {
+        neko::JobSystem::AddJob(job.get(), queueIndex);
+    }
+    chain.back()->Join();
+    neko::JobSystem::End();
+
+    for (int i = 0; i < chainLength; i++)
+    {
+        EXPECT_EQ(chain[i]->GetOrder(), i);
+    }
+}
+
+TEST(JobSystem, DependentAddedBeforeDependency)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(2);
+    neko::JobSystem::Begin();
+
+    int number = 1;
+    ExpectedAssignmentJob<3, 1> firstJob(number);
+    DependentExpectedAssignmentJob<5, 3> secondJob(&firstJob, number);
+    neko::JobSystem::AddJob(&secondJob, queueIndex);
+    EXPECT_FALSE(secondJob.HasStarted());
+    neko::JobSystem::AddJob(&firstJob, queueIndex);
+    secondJob.Join();
+    neko::JobSystem::End();
+
+    EXPECT_EQ(number, 5);
+}
+
+TEST(JobSystem, ParallelFor)
+{
+    constexpr std::size_t count = 100'000;
+    const int queueIndex = neko::JobSystem::SetupNewQueue(4);
+    neko::JobSystem::Begin();
+
+    std::vector<int> values(count, 0);
+    neko::JobSystem::ParallelFor(0, count, [&values](std::size_t i)
+    {
+        values[i]++;
+    }, queueIndex);
+    neko::JobSystem::End();
+
+    EXPECT_TRUE(std::ranges::all_of(values, [](int value) { return value == 1; }));
+}
+
+TEST(JobSystem, ParallelFor2D)
+{
+    constexpr std::size_t width = 37;
+    constexpr std::size_t height = 129;
+    const int queueIndex = neko::JobSystem::SetupNewQueue(4);
+    neko::JobSystem::Begin();
+
+    std::vector<int> values(width * height, 0);
+    neko::JobSystem::ParallelFor2D(1, width, 2, height, [&values](std::size_t x, std::size_t y)
+    {
+        values[y * width + x]++;
+    }, queueIndex, 3);
+    neko::JobSystem::End();
+
+    for (std::size_t y = 0; y < height; y++)
+    {
+        for (std::size_t x = 0; x < width; x++)
+        {
+            EXPECT_EQ(values[y * width + x], x >= 1 && y >= 2 ? 1 : 0);
+        }
+    }
+}
+
+TEST(JobSystem, ParallelForException)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(2);
+    neko::JobSystem::Begin();
+
+    std::atomic<int> visited{0};
+    EXPECT_THROW(neko::JobSystem::ParallelFor(0, 1000, [&visited](std::size_t i)
+    {
+        visited.fetch_add(1, std::memory_order_relaxed);
+        if (i == 500)
+        {
+            throw std::runtime_error("expected");
+        }
+    }, queueIndex, 10), std::runtime_error);
+    neko::JobSystem::End();
+
+    EXPECT_GT(visited.load(), 0);
+}
+
+TEST(JobSystem, SubmitFunction)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(2);
+    neko::JobSystem::Begin();
+
+    int number = 0;
+    auto handle = neko::JobSystem::Submit([&number] { number = 3; }, queueIndex);
+    handle.Join();
+    EXPECT_EQ(number, 3);
+    EXPECT_FALSE(handle.HasFailed());
+
+    // A submitted job can be a dependency, here of a main thread job
+    DependentExpectedAssignmentJob<5, 3> mainJob(handle.GetJob(), number);
+    neko::JobSystem::AddJob(&mainJob, neko::MAIN_QUEUE_INDEX);
+    neko::JobSystem::ExecuteMainThread();
+    EXPECT_EQ(number, 5);
+
+    auto failedHandle = neko::JobSystem::Submit([] { throw std::runtime_error("expected"); }, queueIndex);
+    failedHandle.Join();
+    EXPECT_TRUE(failedHandle.HasFailed());
+    neko::JobSystem::End();
+}
+
+TEST(JobSystem, SubmitRecyclesSlots)
+{
+    constexpr int jobCount = 10'000;
+    const int queueIndex = neko::JobSystem::SetupNewQueue(4);
+    neko::JobSystem::Begin();
+
+    std::atomic<int> counter{0};
+    std::array<std::byte, 2 * neko::FunctionJob::bufferSize> bigCapture{};
+    for (int i = 0; i < jobCount; i++)
+    {
+        if (i % 100 == 0)
+        {
+            // Too big for the inline buffer, falls back to the heap
+            neko::JobSystem::Submit([&counter, bigCapture] { counter.fetch_add(1 + static_cast<int>(bigCapture[0])); }, queueIndex);
+        }
+        else
+        {
+            neko::JobSystem::Submit([&counter] { counter.fetch_add(1); }, queueIndex);
+        }
+    }
+
+    // Round after round, the slots given back are taken again: the pool stays about the size of one
+    // round, a pool leaking its slots would grow by a round every time
+    constexpr int roundCount = 200;
+    constexpr int roundSize = 32;
+    const auto slotCount = neko::JobSystem::GetFunctionJobSlotCount();
+    std::vector<neko::JobHandle> handles;
+    for (int round = 0; round < roundCount; round++)
+    {
+        for (int i = 0; i < roundSize; i++)
+        {
+            handles.push_back(neko::JobSystem::Submit([&counter] { counter.fetch_add(1); }, queueIndex));
+        }
+        for (auto& handle : handles)
+        {
+            handle.Join();
+        }
+        handles.clear();
+    }
+    neko::JobSystem::End();
+
+    EXPECT_EQ(counter.load(), jobCount + roundCount * roundSize);
+    EXPECT_GE(slotCount, static_cast<std::size_t>(roundSize));
+    EXPECT_LE(neko::JobSystem::GetFunctionJobSlotCount(), slotCount + 4 * roundSize);
+}
+
+TEST(JobSystem, MainThreadParksWhileHelping)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(1);
+    neko::JobSystem::Begin();
+
+    // A main queue job waits on the slow worker job, the joining main thread cannot return early
+    int number = 0;
+    auto slowJob = neko::JobSystem::Submit([&number]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        number = 3;
+    }, queueIndex);
+    DependentExpectedAssignmentJob<5, 3> mainJob(slowJob.GetJob(), number);
+    neko::JobSystem::AddJob(&mainJob, neko::MAIN_QUEUE_INDEX);
+    const auto cpuStart = std::clock();
+    slowJob.Join();
+    const auto cpuTime = std::clock() - cpuStart;
+    neko::JobSystem::ExecuteMainThread();
+    neko::JobSystem::End();
+
+    EXPECT_EQ(number, 5);
+    // Parked, not spinning for the 50 ms: the whole process barely used the CPU
+    EXPECT_LT(cpuTime, CLOCKS_PER_SEC / 50);
+}
+
+class LaneRecordingJob : public neko::Job
+{
+public:
+    LaneRecordingJob(std::vector<neko::JobPriority>& order, neko::JobPriority priority) :
+        order_(order), priority_(priority) {}
+    void ExecuteImpl() override
+    {
+        order_.push_back(priority_);
+    }
+private:
+    std::vector<neko::JobPriority>& order_;
+    neko::JobPriority priority_;
+};
+
+TEST(JobSystem, PriorityLanes)
+{
+    // The main queue is only drained by ExecuteMainThread, so everything is queued up front
+    std::vector<neko::JobPriority> order;
+    std::vector<std::unique_ptr<LaneRecordingJob>> jobs;
+    for (const auto priority : {neko::JobPriority::Low, neko::JobPriority::Normal, neko::JobPriority::High})
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            jobs.push_back(std::make_unique<LaneRecordingJob>(order, priority));
+            neko::JobSystem::AddJob(jobs.back().get(), neko::MAIN_QUEUE_INDEX, priority);
+        }
+    }
+    neko::JobSystem::ExecuteMainThread();
+
+    ASSERT_EQ(order.size(), jobs.size());
+    EXPECT_TRUE(std::ranges::is_sorted(order));
+}
+
+TEST(JobSystem, PriorityAging)
+{
+    std::vector<neko::JobPriority> order;
+    std::vector<std::unique_ptr<LaneRecordingJob>> jobs;
+    neko::JobSystem::SetPriorityAging(neko::MAIN_QUEUE_INDEX, 4);
+    for (const auto priority : {neko::JobPriority::Low, neko::JobPriority::High, neko::JobPriority::High,
+        neko::JobPriority::High, neko::JobPriority::High, neko::JobPriority::High})
+    {
+        jobs.push_back(std::make_unique<LaneRecordingJob>(order, priority));
+        neko::JobSystem::AddJob(jobs.back().get(), neko::MAIN_QUEUE_INDEX, priority);
+    }
+    neko::JobSystem::ExecuteMainThread();
+    neko::JobSystem::SetPriorityAging(neko::MAIN_QUEUE_INDEX, 0);
+
+    // The low priority job did not wait for the whole high priority lane
+    ASSERT_EQ(order.size(), jobs.size());
+    EXPECT_NE(order.back(), neko::JobPriority::Low);
+}
+
+TEST(JobSystem, ParkedWorkersWakeUp)
+{
+    const int fifoQueue = neko::JobSystem::SetupNewQueue(2);
+    const int stealingQueue = neko::JobSystem::SetupNewQueue(2, neko::QueueMode::WorkStealing);
+    // Park right away, so that every job below has to wake a sleeping worker
+    neko::JobSystem::SetIdlePolicy(fifoQueue, {0, 0});
+    neko::JobSystem::SetIdlePolicy(stealingQueue, {0, 0});
+    neko::JobSystem::SetIdlePolicy(neko::MAIN_QUEUE_INDEX, {0, 0});
+    neko::JobSystem::Begin();
+
+    std::atomic<int> counter{0};
+    for (int round = 0; round < 20; round++)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        auto handle = neko::JobSystem::Submit([&counter, stealingQueue]
+        {
+            // Children pushed on the worker deque are stolen by its parked sibling
+            std::array<neko::JobHandle, 4> children;
+            for (auto& child : children)
+            {
+                child = neko::JobSystem::Submit([&counter] { counter.fetch_add(1); }, stealingQueue);
+            }
+            for (auto& child : children)
+            {
+                child.Join();
+            }
+        }, stealingQueue);
+        neko::JobSystem::Submit([&counter] { counter.fetch_add(1); }, fifoQueue).Join();
+        handle.Join();
+    }
+    // The main thread parks too while its job waits on a worker
+    int number = 0;
+    auto handle = neko::JobSystem::Submit([&number] { number = 3; }, fifoQueue);
+    DependentExpectedAssignmentJob<5, 3> mainJob(handle.GetJob(), number);
+    neko::JobSystem::AddJob(&mainJob, neko::MAIN_QUEUE_INDEX);
+    neko::JobSystem::ExecuteMainThread();
+    neko::JobSystem::End();
+    // End resets it already, restored anyway so that no later test depends on it
+    neko::JobSystem::SetIdlePolicy(neko::MAIN_QUEUE_INDEX, {});
+
+    EXPECT_EQ(counter.load(), 20 * 5);
+    EXPECT_EQ(number, 5);
+}
+
+TEST(JobSystem, Stats)
+{
+    constexpr int jobCount = 1000;
+    const int queueIndex = neko::JobSystem::SetupNewQueue(2);
+    neko::JobSystem::Begin();
+
+    for (int i = 0; i < jobCount; i++)
+    {
+        neko::JobSystem::Submit([] {}, queueIndex);
+    }
+    // Counters are updated right after the job is done, so Join alone does not guarantee them
+    neko::JobSystemStats stats{};
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    do
+    {
+        stats = neko::JobSystem::GetStats();
+    } while (stats.queues[queueIndex].executedJobs < jobCount && std::chrono::steady_clock::now() < deadline);
+
+    EmptyJob mainJob;
+    neko::JobSystem::AddJob(&mainJob, neko::MAIN_QUEUE_INDEX);
+    neko::JobSystem::ExecuteMainThread();
+    const auto mainStats = neko::JobSystem::GetStats().mainThread;
+    neko::JobSystem::End();
+
+    ASSERT_EQ(stats.workers.size(), 2u);
+    const auto& queueStats = stats.queues[queueIndex];
+    EXPECT_EQ(queueStats.executedJobs, jobCount);
+    EXPECT_EQ(queueStats.startLatency.GetCount(), jobCount);
+    EXPECT_EQ(stats.workers[0].executedJobs + stats.workers[1].executedJobs, jobCount);
+    EXPECT_EQ(stats.workers[1].workerIndex, 1u);
+    EXPECT_GE(mainStats.executedJobs, 1u);
+}
+
+class CountingJob : public neko::Job
+{
+public:
+    explicit CountingJob(std::atomic<int>& counter) : counter_(counter) {}
+    void ExecuteImpl() override { counter_.fetch_add(1); }
+private:
+    std::atomic<int>& counter_;
+};
+
+class BlockingJob : public neko::Job
+{
+public:
+    BlockingJob(std::atomic<int>& counter, int expected) : counter_(counter), expected_(expected) {}
+    void ExecuteImpl() override
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (counter_.load() < expected_ && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::yield();
+        }
+        reachedCount_ = counter_.load();
+    }
+    [[nodiscard]] int GetReachedCount() const { return reachedCount_; }
+private:
+    std::atomic<int>& counter_;
+    int expected_;
+    int reachedCount_ = 0;
+};
+
+TEST(JobSystem, BatchedJobsAreStolen)
+{
+    constexpr int jobCount = 64;
+    const int queueIndex = neko::JobSystem::SetupNewQueue(2);
+
+    std::atomic<int> counter{0};
+    // The first job of a batch blocks until all the others ran: the rest of its batch must be stolen
+    BlockingJob blockingJob(counter, jobCount - 1);
+    std::vector<std::unique_ptr<CountingJob>> countingJobs;
+    std::vector<neko::Job*> jobs{&blockingJob};
+    for (int i = 1; i < jobCount; i++)
+    {
+        countingJobs.push_back(std::make_unique<CountingJob>(counter));
+        jobs.push_back(countingJobs.back().get());
+    }
+    neko::JobSystem::AddJobs(jobs, queueIndex);
+    neko::JobSystem::Begin();
+    blockingJob.Join();
+    neko::JobSystem::End();
+
+    EXPECT_EQ(blockingJob.GetReachedCount(), jobCount - 1);
+    EXPECT_EQ(counter.load(), jobCount - 1);
+}
+
+namespace
+{
+void SubmitAndJoin(int queueIndex, int depth, std::atomic<int>& counter)
+{
+    counter.fetch_add(1);
+    if (depth == 0)
+    {
+        return;
+    }
+    auto handle = neko::JobSystem::Submit([queueIndex, depth, &counter]
+    {
+        SubmitAndJoin(queueIndex, depth - 1, counter);
+    }, queueIndex);
+    handle.Join();
+}
+}
+
+TEST(JobSystem, JoinHelpsOnSingleWorker)
+{
+    // With one worker, joining a job of the same queue used to wait on a job only it could run
+    const int queueIndex = neko::JobSystem::SetupNewQueue(1);
+    neko::JobSystem::Begin();
+
+    std::atomic<int> counter{0};
+    auto handle = neko::JobSystem::Submit([queueIndex, &counter]
+    {
+        SubmitAndJoin(queueIndex, 8, counter);
+    }, queueIndex);
+    handle.Join();
+    neko::JobSystem::End();
+
+    EXPECT_EQ(counter.load(), 9);
+}
+
+TEST(JobSystem, MainThreadJoinHelps)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(1);
+    neko::JobSystem::Begin();
+
+    int number = 0;
+    auto handle = neko::JobSystem::Submit([&number] { number = 3; }, queueIndex);
+    DependentExpectedAssignmentJob<5, 3> mainJob(handle.GetJob(), number);
+    neko::JobSystem::AddJob(&mainJob, neko::MAIN_QUEUE_INDEX);
+    // No ExecuteMainThread: the main thread runs its job while joining it
+    mainJob.Join();
+    neko::JobSystem::End();
+
+    EXPECT_EQ(number, 5);
+}
+
+class GatedJob : public neko::Job
+{
+public:
+    explicit GatedJob(const std::atomic<bool>& isReady) : isReady_(isReady) {}
+    [[nodiscard]] bool ShouldStart() const override { return isReady_.load(std::memory_order_acquire); }
+    bool hasRun = false;
+protected:
+    void ExecuteImpl() override { hasRun = true; }
+private:
+    const std::atomic<bool>& isReady_;
+};
+
+TEST(JobSystem, MainThreadBudget)
+{
+    neko::JobSystem::Begin();
+
+    int executed = 0;
+    std::atomic<bool> isReady{false};
+    GatedJob gatedJob(isReady);
+    neko::JobSystem::AddJob(&gatedJob, neko::MAIN_QUEUE_INDEX);
+    std::vector<neko::JobHandle> handles;
+    for (int i = 0; i < 10; i++)
+    {
+        handles.push_back(neko::JobSystem::Submit([&executed] { executed++; }));
+    }
+
+    EXPECT_EQ(neko::JobSystem::ExecuteMainThread({.maxJobCount = 3}), 3u);
+    EXPECT_EQ(executed, 3);
+    // An already spent deadline runs nothing
+    EXPECT_EQ(neko::JobSystem::ExecuteMainThread(neko::MainThreadBudget::FromDuration(std::chrono::nanoseconds(-1))), 0u);
+    EXPECT_EQ(executed, 3);
+    // Only the gated job is left: the call returns instead of spinning on it
+    EXPECT_EQ(neko::JobSystem::ExecuteMainThread(neko::MainThreadBudget::FromDuration(std::chrono::seconds(10))), 7u);
+    EXPECT_EQ(executed, 10);
+    EXPECT_EQ(neko::JobSystem::ExecuteMainThread({}), 0u);
+    EXPECT_FALSE(gatedJob.hasRun);
+
+    isReady.store(true, std::memory_order_release);
+    EXPECT_EQ(neko::JobSystem::ExecuteMainThread({}), 1u);
+    EXPECT_TRUE(gatedJob.hasRun);
+    neko::JobSystem::End();
+}
+
+TEST(JobSystem, JobCounter)
+{
+    constexpr int jobCount = 100;
+    const int queueIndex = neko::JobSystem::SetupNewQueue(4);
+    neko::JobSystem::Begin();
+
+    neko::JobCounter counter;
+    EXPECT_TRUE(counter.IsDone());
+    std::atomic<int> executed{0};
+    std::vector<std::unique_ptr<CountingJob>> jobs;
+    std::vector<neko::Job*> jobPtrs;
+    for (int i = 0; i < jobCount; i++)
+    {
+        jobs.push_back(std::make_unique<CountingJob>(executed));
+        jobPtrs.push_back(jobs.back().get());
+    }
+    // Reused every frame, and fanned in by a dependent main thread job
+    for (int frame = 0; frame < 3; frame++)
+    {
+        int number = 3;
+        DependentExpectedAssignmentJob<5, 3> fanIn(&counter, number);
+        neko::JobSystem::AddJobs(jobPtrs, counter, queueIndex);
+        neko::JobSystem::AddJob(&fanIn, neko::MAIN_QUEUE_INDEX);
+        counter.Wait();
+        EXPECT_EQ(executed.load(), (frame + 1) * jobCount);
+        EXPECT_EQ(counter.GetCount(), 0);
+        neko::JobSystem::ExecuteMainThread();
+        EXPECT_EQ(number, 5);
+    }
+    neko::JobSystem::End();
+}
+
+class SquareValueJob : public neko::DependentJob
+{
+public:
+    SquareValueJob(neko::ValueJob<int>* valueJob) : neko::DependentJob(valueJob), valueJob_(valueJob) {}
+    int result = 0;
+protected:
+    void ExecuteImpl() override
+    {
+        const int value = valueJob_->Get();
+        result = value * value;
+    }
+private:
+    neko::ValueJob<int>* valueJob_;
+};
+
+TEST(JobSystem, ValueJob)
+{
+    const int queueIndex = neko::JobSystem::SetupNewQueue(2);
+    neko::JobSystem::Begin();
+
+    neko::FunctionValueJob valueJob([]{ return 7; });
+    SquareValueJob squareJob(&valueJob);
+    neko::FunctionValueJob stringJob([]{ return std::string(100, 'a'); });
+    neko::FunctionValueJob throwingJob([]() -> int { throw std::logic_error("value job"); });
+    neko::JobSystem::AddJob(&valueJob, queueIndex);
+    neko::JobSystem::AddJob(&squareJob, queueIndex);
+    neko::JobSystem::AddJob(&stringJob, queueIndex);
+    neko::JobSystem::AddJob(&throwingJob, queueIndex);
+
+    EXPECT_EQ(valueJob.Get(), 7);
+    EXPECT_TRUE(valueJob.HasValue());
+    EXPECT_EQ(stringJob.Get().size(), 100u);
+    squareJob.Join();
+    EXPECT_EQ(squareJob.result, 49);
+    EXPECT_THROW(throwingJob.Get(), std::logic_error);
+    EXPECT_TRUE(throwingJob.HasFailed());
+    EXPECT_FALSE(throwingJob.HasValue());
+
+    // Reused after a reset, the value is computed again
+    valueJob.Reset();
+    neko::JobSystem::AddJob(&valueJob, queueIndex);
+    EXPECT_EQ(valueJob.Get(), 7);
+
+    std::atomic<bool> cancelled{true};
+    neko::FunctionValueJob cancelledJob([]{ return 1; });
+    cancelledJob.SetCancelFlag(&cancelled);
+    neko::JobSystem::AddJob(&cancelledJob, queueIndex);
+    EXPECT_THROW(cancelledJob.Get(), std::runtime_error);
+    neko::JobSystem::End();
+}
+
+TEST(JobScheduler, IndependentSchedulers)
+{
+    constexpr int jobCount = 64;
+    neko::JobScheduler first;
+    neko::JobScheduler second;
+    const int firstQueue = first.SetupNewQueue(2);
+    const int secondQueue = second.SetupNewQueue(2, neko::QueueMode::WorkStealing);
+    first.Begin();
+    second.Begin();
+
+    std::atomic<int> firstExecuted{0};
+    std::atomic<int> secondExecuted{0};
+    std::vector<std::unique_ptr<CountingJob>> jobs;
+    std::vector<neko::Job*> firstJobs;
+    std::vector<neko::Job*> secondJobs;
+    for (int i = 0; i < jobCount; i++)
+    {
+        jobs.push_back(std::make_unique<CountingJob>(firstExecuted));
+        firstJobs.push_back(jobs.back().get());
+        jobs.push_back(std::make_unique<CountingJob>(secondExecuted));
+        secondJobs.push_back(jobs.back().get());
+    }
+    neko::JobCounter firstCounter;
+    neko::JobCounter secondCounter;
+    first.AddJobs(firstJobs, firstCounter, firstQueue);
+    second.AddJobs(secondJobs, secondCounter, secondQueue);
+    // A dependent job added to the first scheduler waits on a job of the second one
+    int number = 3;
+    DependentExpectedAssignmentJob<5, 3> crossJob(secondJobs.front(), number);
+    first.AddJob(&crossJob, firstQueue);
+    firstCounter.Wait();
+    secondCounter.Wait();
+    crossJob.Join();
+    EXPECT_EQ(crossJob.GetScheduler(), &first);
+    EXPECT_EQ(secondJobs.front()->GetScheduler(), &second);
+
+    const auto firstStats = first.GetStats();
+    const auto secondStats = second.GetStats();
+    first.End();
+    second.End();
+
+    EXPECT_EQ(firstExecuted.load(), jobCount);
+    EXPECT_EQ(secondExecuted.load(), jobCount);
+    EXPECT_EQ(number, 5);
+    EXPECT_EQ(firstStats.queues[0].executedJobs, static_cast<std::uint64_t>(jobCount + 1));
+    EXPECT_EQ(secondStats.queues[0].executedJobs, static_cast<std::uint64_t>(jobCount));
+}
+
+TEST(JobScheduler, PauseResume)
+{
+    constexpr int jobCount = 32;
+    neko::JobScheduler scheduler;
+    const int queueIndex = scheduler.SetupNewQueue(4);
+    scheduler.Begin();
+
+    std::atomic<int> executed{0};
+    std::vector<std::unique_ptr<CountingJob>> jobs;
+    std::vector<neko::Job*> jobPtrs;
+    for (int i = 0; i < jobCount; i++)
+    {
+        jobs.push_back(std::make_unique<CountingJob>(executed));
+        jobPtrs.push_back(jobs.back().get());
+    }
+    for (int run = 0; run < 3; run++)
+    {
+        scheduler.AddJobs(jobPtrs, queueIndex);
+        // Pause returns once the queued jobs are done
+        scheduler.Pause();
+        EXPECT_TRUE(scheduler.IsPaused());
+        EXPECT_EQ(executed.load(), (run + 1) * jobCount);
+
+        // Added while paused, it waits for Resume
+        scheduler.AddJob(jobPtrs.front(), queueIndex);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        EXPECT_FALSE(jobPtrs.front()->IsDone());
+        executed.fetch_sub(1);
+        scheduler.Resume();
+        jobPtrs.front()->Join();
+    }
+    // End still runs the jobs added while paused
+    scheduler.Pause();
+    scheduler.AddJob(jobPtrs.front(), queueIndex);
+    scheduler.End();
+    EXPECT_TRUE(jobPtrs.front()->IsDone());
+    EXPECT_FALSE(scheduler.IsRunning());
+}
+
+class PausingJob : public neko::Job
+{
+public:
+    bool hasThrown = false;
+protected:
+    void ExecuteImpl() override
+    {
+        try
+        {
+            GetScheduler()->Pause();
+        }
+        catch (const std::logic_error&)
+        {
+            hasThrown = true;
+        }
+    }
+};
+
+TEST(JobScheduler, PauseFromOwnWorkerThrows)
+{
+    neko::JobScheduler scheduler;
+    const int queueIndex = scheduler.SetupNewQueue(1);
+    scheduler.Begin();
+    PausingJob pausingJob;
+    scheduler.AddJob(&pausingJob, queueIndex);
+    pausingJob.Join();
+    EXPECT_TRUE(pausingJob.hasThrown);
+    EXPECT_FALSE(scheduler.IsPaused());
+    scheduler.End();
+}
+
+TEST(JobScheduler, EndDropsMainThreadReservations)
+{
+    neko::JobScheduler scheduler;
+    scheduler.Begin();
+    // Counted as pending on the main thread, but its dependency is never added
+    EmptyJob neverAdded;
+    EmptyDependentJob dependentJob{&neverAdded};
+    scheduler.AddJob(&dependentJob, neko::MAIN_QUEUE_INDEX);
+    EmptyJob queuedJob;
+    scheduler.AddJob(&queuedJob, neko::MAIN_QUEUE_INDEX);
+    scheduler.End();
+
+    // The queued job still runs, and ExecuteMainThread does not wait for the dependent one
+    scheduler.Begin();
+    scheduler.ExecuteMainThread();
+    EXPECT_TRUE(queuedJob.IsDone());
+    EXPECT_FALSE(dependentJob.IsDone());
+    scheduler.End();
+}
+
+TEST(JobScheduler, Timers)
+{
+    using namespace std::chrono_literals;
+    neko::JobScheduler scheduler;
+    const int queueIndex = scheduler.SetupNewQueue(2);
+    scheduler.Begin();
+
+    std::atomic<int> delayed{0};
+    std::atomic<int> periodic{0};
+    std::atomic<int> cancelled{0};
+    CountingJob delayedJob{delayed};
+    CountingJob periodicJob{periodic};
+    CountingJob cancelledJob{cancelled};
+    const auto start = std::chrono::steady_clock::now();
+    scheduler.AddJobAfter(&delayedJob, 20ms, queueIndex);
+    const auto periodicId = scheduler.AddPeriodicJob(&periodicJob, 5ms, queueIndex);
+    const auto cancelledId = scheduler.AddJobAfter(&cancelledJob, 10s, queueIndex);
+    EXPECT_NE(periodicId, neko::INVALID_TIMER_ID);
+
+    while (delayed.load() == 0 || periodic.load() < 3)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+    delayedJob.Join();
+    EXPECT_TRUE(scheduler.CancelTimer(periodicId));
+    EXPECT_TRUE(scheduler.CancelTimer(cancelledId));
+    EXPECT_FALSE(scheduler.CancelTimer(cancelledId));
+    periodicJob.Join();
+    const auto periodicCount = periodic.load();
+    std::this_thread::sleep_for(20ms);
+    // At most one run expired just before the cancel
+    EXPECT_LE(periodic.load(), periodicCount + 1);
+
+    // No delay adds the job right away
+    EXPECT_EQ(scheduler.AddJobAfter(&delayedJob, 0ms, queueIndex), neko::INVALID_TIMER_ID);
+    delayedJob.Join();
+    scheduler.End();
+    EXPECT_EQ(delayed.load(), 2);
+    EXPECT_EQ(cancelled.load(), 0);
+}
@@ -0,0 +1,141 @@
+#include "thread/parallel_algorithm.h"
+#include "container/vector.h"
+#include "gtest/gtest.h"
+
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+std::vector<int> MakeRandomValues(std::size_t size)
+{
+    std::mt19937 generator{42};
+    std::uniform_int_distribution distribution{-1000, 1000};
+    std::vector<int> values(size);
+    for (auto& value : values)
+    {
+        value = distribution(generator);
+    }
+    return values;
+}
+}
+
+class ParallelAlgorithm : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        queueIndex_ = neko::JobSystem::SetupNewQueue(4);
+        neko::JobSystem::Begin();
+    }
+
+    void TearDown() override
+    {
+        neko::JobSystem::End();
+    }
+
+    int queueIndex_ = 0;
+};
+
+TEST_F(ParallelAlgorithm, ForEach)
+{
+    std::vector<int> values(10'000);
+    std::iota(values.begin(), values.end(), 0);
+    neko::Parallel::ForEach(values, [](int& value) { value *= 2; }, queueIndex_);
+    for (std::size_t i = 0; i < values.size(); i++)
+    {
+        EXPECT_EQ(values[i], static_cast<int>(i) * 2);
+    }
+
+    neko::SmallVector<int, 1024> smallValues{};
+    for (int i = 0; i < 1024; i++)
+    {
+        smallValues.push_back(i);
+    }
+    neko::Parallel::ForEach(smallValues, [](int& value) { value++; }, queueIndex_, 16);
+    EXPECT_EQ(smallValues[1023], 1024);
+}
+
+TEST_F(ParallelAlgorithm, ReduceAndTransformReduce)
+{
+    for (const std::size_t size : {0u, 1u, 511u, 513u, 100'000u})
+    {
+        const auto values = MakeRandomValues(size);
+        const auto expected = std::accumulate(values.begin(), values.end(), 7LL);
+        EXPECT_EQ(neko::Parallel::Reduce(values, 7LL, queueIndex_), expected);
+        long long expectedSquares = 0;
+        for (const auto value : values)
+        {
+            expectedSquares += static_cast<long long>(value) * value;
+        }
+        EXPECT_EQ(neko::Parallel::TransformReduce(values, 0LL, std::plus<>{},
+            [](int value) { return static_cast<long long>(value) * value; }, queueIndex_), expectedSquares);
+    }
+    // Associative but not commutative: the blocks are combined in order
+    std::vector<std::string> words(2000, "a");
+    words[1999] = "b";
+    const auto concatenated = neko::Parallel::Reduce(words, std::string{}, queueIndex_, std::plus<>{}, 7);
+    EXPECT_EQ(concatenated.size(), 2000u);
+    EXPECT_EQ(concatenated.back(), 'b');
+}
+
+TEST_F(ParallelAlgorithm, InclusiveScan)
+{
+    for (const std::size_t size : {1u, 512u, 1500u, 100'001u})
+    {
+        const auto values = MakeRandomValues(size);
+        std::vector<int> expected(size);
+        std::inclusive_scan(values.begin(), values.end(), expected.begin());
+
+        std::vector<int> output(size);
+        neko::Parallel::InclusiveScan(values, output, queueIndex_);
+        EXPECT_EQ(output, expected);
+
+        auto inPlace = values;
+        neko::Parallel::InclusiveScan(inPlace, inPlace, queueIndex_, std::plus<>{}, 100);
+        EXPECT_EQ(inPlace, expected);
+    }
+}
+
+TEST_F(ParallelAlgorithm, Sort)
+{
+    for (const std::size_t size : {0u, 2u, 700u, 3000u, 100'000u, 123'457u})
+    {
+        auto values = MakeRandomValues(size);
+        auto expected = values;
+        std::ranges::sort(expected);
+        neko::Parallel::Sort(values, queueIndex_);
+        EXPECT_EQ(values, expected);
+    }
+    auto values = MakeRandomValues(10'000);
+    neko::Parallel::Sort(values, queueIndex_, std::greater<>{}, 300);
+    EXPECT_TRUE(std::ranges::is_sorted(values, std::greater<>{}));
+}
+
+TEST_F(ParallelAlgorithm, Partition)
+{
+    for (const std::size_t size : {0u, 100u, 5000u, 100'000u})
+    {
+        auto values = MakeRandomValues(size);
+        auto expected = values;
+        const auto isEven = [](int value) { return value % 2 == 0; };
+        const auto expectedPoint = std::stable_partition(expected.begin(), expected.end(), isEven) - expected.begin();
+        EXPECT_EQ(neko::Parallel::Partition(values, isEven, queueIndex_), static_cast<std::size_t>(expectedPoint));
+        EXPECT_EQ(values, expected);
+    }
+}
+
+TEST_F(ParallelAlgorithm, FromInsideJob)
+{
+    auto values = MakeRandomValues(50'000);
+    auto expected = values;
+    std::ranges::sort(expected);
+    auto handle = neko::JobSystem::Submit([&values, this]
+    {
+        neko::Parallel::Sort(values, queueIndex_);
+    }, queueIndex_);
+    handle.Join();
+    EXPECT_EQ(values, expected);
+}
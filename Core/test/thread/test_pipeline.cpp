@@ -0,0 +1,150 @@
+#include "thread/pipeline.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+struct Item
+{
+    int index = 0;
+    int value = 0;
+};
+}
+
+class PipelineTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        queueIndex_ = neko::JobSystem::SetupNewQueue(4);
+        neko::JobSystem::Begin();
+    }
+    void TearDown() override
+    {
+        neko::JobSystem::End();
+    }
+    int queueIndex_ = 0;
+};
+
+TEST_F(PipelineTest, StagesKeepTheirOrderAndTokenBound)
+{
+    constexpr int itemCount = 1000;
+    constexpr std::size_t tokenCount = 4;
+    int nextIndex = 0;
+    std::atomic<int> inFlight{0};
+    std::atomic<int> maxInFlight{0};
+    std::atomic<int> parallelCount{0};
+    std::atomic<int> serialRunning{0};
+    bool serialOverlapped = false;
+    int outOfOrderCount = 0;
+    std::vector<int> output;
+
+    neko::Pipeline<Item> pipeline(tokenCount, [&](Item& item)
+    {
+        if (nextIndex == itemCount)
+        {
+            return false;
+        }
+        item.index = nextIndex++;
+        const auto current = inFlight.fetch_add(1) + 1;
+        auto previous = maxInFlight.load();
+        while (current > previous && !maxInFlight.compare_exchange_weak(previous, current)) {}
+        return true;
+    });
+    pipeline.AddStage(neko::StageMode::Parallel, [&](Item& item)
+    {
+        // Uneven work, so that the items reach the next stages out of order
+        if (item.index % 7 == 0)
+        {
+            std::this_thread::yield();
+        }
+        item.value = item.index * 2;
+        parallelCount++;
+    }).AddStage(neko::StageMode::SerialOutOfOrder, [&](Item&)
+    {
+        serialOverlapped |= serialRunning.fetch_add(1) != 0;
+        outOfOrderCount++;
+        serialRunning.fetch_sub(1);
+    }).AddStage(neko::StageMode::SerialInOrder, [&](Item& item)
+    {
+        output.push_back(item.value);
+        inFlight.fetch_sub(1);
+    });
+
+    for (int run = 0; run < 2; run++)
+    {
+        nextIndex = 0;
+        output.clear();
+        outOfOrderCount = 0;
+        parallelCount = 0;
+        pipeline.Run(queueIndex_);
+        EXPECT_TRUE(pipeline.IsDone());
+        EXPECT_EQ(pipeline.GetItemCount(), static_cast<std::uint64_t>(itemCount));
+        EXPECT_EQ(parallelCount.load(), itemCount);
+        EXPECT_EQ(outOfOrderCount, itemCount);
+        ASSERT_EQ(output.size(), static_cast<std::size_t>(itemCount));
+        for (int i = 0; i < itemCount; i++)
+        {
+            EXPECT_EQ(output[i], i * 2);
+        }
+    }
+    EXPECT_FALSE(serialOverlapped);
+    EXPECT_LE(maxInFlight.load(), static_cast<int>(tokenCount));
+}
+
+TEST_F(PipelineTest, EmptyInput)
+{
+    int stageCount = 0;
+    neko::Pipeline<Item> pipeline(2, [](Item&) { return false; });
+    pipeline.AddStage(neko::StageMode::SerialInOrder, [&stageCount](Item&) { stageCount++; });
+    pipeline.Run(queueIndex_);
+    EXPECT_EQ(stageCount, 0);
+    EXPECT_EQ(pipeline.GetItemCount(), 0u);
+}
+
+TEST_F(PipelineTest, ExceptionStopsThePipeline)
+{
+    std::atomic<int> readCount{0};
+    neko::Pipeline<Item> pipeline(4, [&readCount](Item& item)
+    {
+        item.index = readCount++;
+        return true;
+    });
+    pipeline.AddStage(neko::StageMode::Parallel, [](Item& item)
+    {
+        if (item.index == 100)
+        {
+            throw std::runtime_error("stage");
+        }
+    }).AddStage(neko::StageMode::SerialInOrder, [](Item&) {});
+    EXPECT_THROW(pipeline.Run(queueIndex_), std::runtime_error);
+    EXPECT_TRUE(pipeline.IsDone());
+    EXPECT_GT(readCount.load(), 100);
+}
+
+TEST(Pipeline, WaitHelpsItsOwnScheduler)
+{
+    // Only the main thread runs the stages of a main queue pipeline, Wait must help that scheduler
+    neko::JobScheduler scheduler;
+    scheduler.Begin();
+    int nextIndex = 0;
+    int sum = 0;
+    neko::Pipeline<Item> pipeline(2, [&nextIndex](Item& item)
+    {
+        if (nextIndex == 100)
+        {
+            return false;
+        }
+        item.value = nextIndex++;
+        return true;
+    });
+    pipeline.AddStage(neko::StageMode::SerialInOrder, [&sum](Item& item) { sum += item.value; });
+    pipeline.Run(neko::MAIN_QUEUE_INDEX, scheduler);
+    scheduler.End();
+    EXPECT_TRUE(pipeline.IsDone());
+    EXPECT_EQ(sum, 99 * 100 / 2);
+}
@@ -0,0 +1,137 @@
+#include "thread/timer_wheel.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+class EmptyJob : public neko::Job
+{
+    void ExecuteImpl() override {}
+};
+
+using namespace std::chrono_literals;
+using Clock = neko::TimerWheel::Clock;
+
+std::vector<neko::Job*> AdvanceTo(neko::TimerWheel& wheel, Clock::time_point now)
+{
+    std::vector<neko::ExpiredTimer> expired;
+    wheel.Advance(now, expired);
+    std::vector<neko::Job*> jobs;
+    for (const auto& timer : expired)
+    {
+        jobs.push_back(timer.job);
+    }
+    return jobs;
+}
+}
+
+TEST(TimerWheel, NeverFiresEarly)
+{
+    const auto start = Clock::now();
+    neko::TimerWheel wheel{1ms, start};
+    EmptyJob job;
+    wheel.Add(&job, start + 10ms + 500us);
+    EXPECT_TRUE(AdvanceTo(wheel, start + 10ms).empty());
+    ASSERT_TRUE(wheel.GetNextDeadline().has_value());
+    EXPECT_EQ(*wheel.GetNextDeadline(), start + 11ms);
+    EXPECT_EQ(AdvanceTo(wheel, start + 11ms), std::vector<neko::Job*>{&job});
+    EXPECT_TRUE(wheel.IsEmpty());
+    EXPECT_FALSE(wheel.GetNextDeadline().has_value());
+}
+
+TEST(TimerWheel, CascadesEveryLevel)
+{
+    const auto start = Clock::now();
+    neko::TimerWheel wheel{1ms, start};
+    // Level 0, 1, 2, 3 and the overflow list
+    const std::vector<Clock::duration> delays{5ms, 100ms, 5s, 300s, 10h};
+    std::vector<EmptyJob> jobs(delays.size());
+    for (std::size_t i = 0; i < delays.size(); i++)
+    {
+        wheel.Add(&jobs[i], start + delays[i]);
+    }
+    std::vector<neko::Job*> order;
+    // Walking deadline to deadline never skips a timer nor fires one early
+    while (const auto deadline = wheel.GetNextDeadline())
+    {
+        std::vector<neko::ExpiredTimer> expired;
+        wheel.Advance(*deadline - 1us, expired);
+        EXPECT_TRUE(expired.empty());
+        for (const auto* job : AdvanceTo(wheel, *deadline))
+        {
+            const auto index = static_cast<std::size_t>(static_cast<const EmptyJob*>(job) - jobs.data());
+            EXPECT_EQ(*deadline, start + delays[index]);
+            order.push_back(const_cast<neko::Job*>(job));
+        }
+    }
+    ASSERT_EQ(order.size(), jobs.size());
+    for (std::size_t i = 0; i < jobs.size(); i++)
+    {
+        EXPECT_EQ(order[i], &jobs[i]);
+    }
+}
+
+TEST(TimerWheel, LateAdvanceFiresInOrder)
+{
+    const auto start = Clock::now();
+    neko::TimerWheel wheel{1ms, start};
+    std::vector<EmptyJob> jobs(100);
+    for (std::size_t i = 0; i < jobs.size(); i++)
+    {
+        // Spread over several levels, added in reverse
+        wheel.Add(&jobs[jobs.size() - 1 - i], start + std::chrono::milliseconds((jobs.size() - i) * 37));
+    }
+    const auto fired = AdvanceTo(wheel, start + 1h);
+    ASSERT_EQ(fired.size(), jobs.size());
+    for (std::size_t i = 0; i < jobs.size(); i++)
+    {
+        EXPECT_EQ(fired[i], &jobs[i]);
+    }
+}
+
+TEST(TimerWheel, Cancel)
+{
+    const auto start = Clock::now();
+    neko::TimerWheel wheel{1ms, start};
+    EmptyJob first;
+    EmptyJob second;
+    const auto firstId = wheel.Add(&first, start + 100ms);
+    wheel.Add(&second, start + 100ms);
+    EXPECT_NE(firstId, neko::INVALID_TIMER_ID);
+    EXPECT_TRUE(wheel.Cancel(firstId));
+    EXPECT_FALSE(wheel.Cancel(firstId));
+    EXPECT_EQ(wheel.GetCount(), 1u);
+    // The slot is reused, the stale id must not cancel the new timer
+    const auto thirdId = wheel.Add(&first, start + 200ms);
+    EXPECT_NE(thirdId, firstId);
+    EXPECT_FALSE(wheel.Cancel(firstId));
+    EXPECT_EQ(AdvanceTo(wheel, start + 150ms), std::vector<neko::Job*>{&second});
+    EXPECT_TRUE(wheel.Cancel(thirdId));
+    EXPECT_TRUE(AdvanceTo(wheel, start + 300ms).empty());
+    EXPECT_TRUE(wheel.IsEmpty());
+}
+
+TEST(TimerWheel, Periodic)
+{
+    const auto start = Clock::now();
+    neko::TimerWheel wheel{1ms, start};
+    EmptyJob job;
+    const auto timerId = wheel.Add(&job, start + 10ms, 10ms);
+    std::vector<neko::ExpiredTimer> expired;
+    wheel.Advance(start + 10ms, expired);
+    ASSERT_EQ(expired.size(), 1u);
+    EXPECT_FALSE(expired[0].isRepeat);
+    expired.clear();
+    wheel.Advance(start + 25ms, expired);
+    ASSERT_EQ(expired.size(), 1u);
+    EXPECT_TRUE(expired[0].isRepeat);
+    // Missed periods are skipped, the due times stay on the 10 ms grid
+    expired.clear();
+    wheel.Advance(start + 1000ms, expired);
+    EXPECT_EQ(expired.size(), 1u);
+    EXPECT_EQ(*wheel.GetNextDeadline(), start + 1010ms);
+    EXPECT_TRUE(wheel.Cancel(timerId));
+    EXPECT_TRUE(wheel.IsEmpty());
+}
@@ -0,0 +1,80 @@
+#include "thread/work_stealing_deque.h"
+#include "gtest/gtest.h"
+
+#include <thread>
+
+TEST(WorkStealingDeque, PopIsLifoStealIsFifo)
+{
+    neko::WorkStealingDeque<int*> deque{2};
+    int values[5]{};
+    for (auto& value : values)
+    {
+        deque.Push(&value);
+    }
+    EXPECT_EQ(deque.SizeApprox(), 5);
+
+    int* out = nullptr;
+    EXPECT_TRUE(deque.Pop(out));
+    EXPECT_EQ(out, &values[4]);
+    EXPECT_TRUE(deque.Steal(out));
+    EXPECT_EQ(out, &values[0]);
+    EXPECT_TRUE(deque.Steal(out));
+    EXPECT_EQ(out, &values[1]);
+    EXPECT_TRUE(deque.Pop(out));
+    EXPECT_EQ(out, &values[3]);
+    EXPECT_TRUE(deque.Pop(out));
+    EXPECT_EQ(out, &values[2]);
+
+    EXPECT_TRUE(deque.IsEmpty());
+    EXPECT_FALSE(deque.Pop(out));
+    EXPECT_FALSE(deque.Steal(out));
+}
+
+TEST(WorkStealingDeque, ConcurrentSteal)
+{
+    constexpr int itemCount = 10'000;
+    constexpr int thiefCount = 3;
+    neko::WorkStealingDeque<int*> deque;
+    std::vector<int> items(itemCount, 0);
+    std::atomic<bool> ownerDone{false};
+
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < thiefCount; i++)
+    {
+        thieves.emplace_back([&deque, &ownerDone]
+        {
+            int* out = nullptr;
+            while (!ownerDone.load(std::memory_order_acquire) || !deque.IsEmpty())
+            {
+                if (deque.Steal(out))
+                {
+                    (*out)++;
+                }
+            }
+        });
+    }
+    for (auto& item : items)
+    {
+        deque.Push(&item);
+        int* out = nullptr;
+        if ((&item - items.data()) % 3 == 0 && deque.Pop(out))
+        {
+            (*out)++;
+        }
+    }
+    ownerDone.store(true, std::memory_order_release);
+    for (auto& thief : thieves)
+    {
+        thief.join();
+    }
+    int* out = nullptr;
+    while (deque.Pop(out))
+    {
+        (*out)++;
+    }
+    // Every item was taken exactly once, either by the owner or by a thief
+    for (const auto item : items)
+    {
+        EXPECT_EQ(item, 1);
+    }
+}
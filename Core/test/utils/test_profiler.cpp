@@ -0,0 +1,90 @@
+#include "utils/profiler.h"
+#include "thread/job_system.h"
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace
+{
+std::size_t CountOccurrences(const std::string& text, std::string_view pattern)
+{
+    std::size_t count = 0;
+    for (auto position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + 1))
+    {
+        count++;
+    }
+    return count;
+}
+}
+
+TEST(Profiler, ScopedZonesExportAsChromeTrace)
+{
+    neko::Profiler::Clear();
+    neko::Profiler::SetThreadName("Main \"test\"");
+    {
+        neko::Profiler::ScopedZone outer("Outer");
+        for (int i = 0; i < 10; i++)
+        {
+            neko::Profiler::ScopedZone inner("Inner");
+        }
+    }
+    std::thread thread([]
+    {
+        neko::Profiler::SetThreadName("Other");
+        neko::Profiler::ScopedZone zone("OtherZone");
+    });
+    thread.join();
+
+    std::ostringstream out;
+    EXPECT_EQ(neko::Profiler::WriteChromeTrace(out), 12u);
+    const auto trace = out.str();
+    EXPECT_EQ(trace.find(R"({"displayTimeUnit":"ns","traceEvents":[)"), 0u);
+    EXPECT_EQ(CountOccurrences(trace, R"("name":"Inner","ph":"X")"), 10u);
+    EXPECT_EQ(CountOccurrences(trace, R"("name":"Outer","ph":"X")"), 1u);
+    EXPECT_EQ(CountOccurrences(trace, R"("name":"OtherZone","ph":"X")"), 1u);
+    EXPECT_NE(trace.find(R"("args":{"name":"Main \"test\""})"), std::string::npos);
+    EXPECT_NE(trace.find(R"("args":{"name":"Other"})"), std::string::npos);
+
+    // Drained events are not exported twice
+    std::ostringstream again;
+    EXPECT_EQ(neko::Profiler::WriteChromeTrace(again), 0u);
+}
+
+TEST(Profiler, FullRingDropsEvents)
+{
+    neko::Profiler::Clear();
+    const auto dropped = neko::Profiler::GetDroppedCount();
+    for (std::size_t i = 0; i < neko::Profiler::ThreadBuffer::CAPACITY + 5; i++)
+    {
+        neko::Profiler::ScopedZone zone("Zone");
+    }
+    EXPECT_EQ(neko::Profiler::GetDroppedCount() - dropped, 5u);
+    std::ostringstream out;
+    EXPECT_EQ(neko::Profiler::WriteChromeTrace(out), neko::Profiler::ThreadBuffer::CAPACITY);
+}
+
+TEST(Profiler, ProfilesJobs)
+{
+    neko::Profiler::Clear();
+    const int queueIndex = neko::JobSystem::SetupNewQueue(2);
+    neko::JobSystem::Begin();
+    neko::FunctionValueJob job([]
+    {
+        neko::Profiler::ScopedZone zone("UserJob");
+        return 1;
+    });
+    neko::JobSystem::AddJob(&job, queueIndex);
+    EXPECT_EQ(job.Get(), 1);
+    neko::JobSystem::End();
+
+    std::ostringstream out;
+    neko::Profiler::WriteChromeTrace(out);
+    const auto trace = out.str();
+    EXPECT_EQ(CountOccurrences(trace, R"("name":"UserJob")"), 1u);
+#ifdef NEKO_PROFILER_ENABLE
+    EXPECT_NE(trace.find("Worker q"), std::string::npos);
+    EXPECT_NE(trace.find(R"("name":"Job::Execute")"), std::string::npos);
+#endif
+}